@@ -0,0 +1,177 @@
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+
+// LRUCache as it was before the slab rewrite, kept for comparison in
+// lru_cache_bench. Not used by the application.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class LegacyLRUCache
+{
+public:
+    using EvictCallback = std::function<void(V &)>;
+
+    LegacyLRUCache() {}
+
+    // LRUCache(size_t capacity, EvictCallback onEvict)
+    //     : m_capacity(capacity), m_onEvict(onEvict)
+    // {
+    // }
+
+    inline void setCapacity(const size_t capacity)
+    {
+        m_capacity = capacity;
+    }
+
+    // Upper bound on the summed weight of all entries, entries put without a
+    // weight count as 1
+    inline void setMaxWeight(const size_t maxWeight)
+    {
+        m_max_weight = maxWeight;
+        trim();
+    }
+
+    inline size_t weight() const
+    {
+        return m_weight;
+    }
+
+    inline void setCallback(EvictCallback onEvict)
+    {
+        m_onEvict = onEvict;
+    }
+
+    V *get(const K &key)
+    {
+        auto it = m_map.find(key);
+        if (it == m_map.end())
+            return nullptr;
+
+        m_list.splice(m_list.begin(), m_list, it->second.it);
+        return &(it->second.value);
+    }
+
+    inline bool has(const K &key) const
+    {
+        return m_map.find(key) != m_map.end();
+    }
+
+    void put(const K &key, V value, size_t weight = 1)
+    {
+        if (m_capacity == 0)
+            return;
+
+        auto it = m_map.find(key);
+        if (it != m_map.end())
+        {
+            m_weight = m_weight - it->second.weight + weight;
+            it->second.value  = std::move(value);
+            it->second.weight = weight;
+            m_list.splice(m_list.begin(), m_list, it->second.it);
+            trim();
+            return;
+        }
+
+        m_list.push_front(key);
+        m_map[key] = {std::move(value), weight, m_list.begin()};
+        m_weight += weight;
+        trim();
+    }
+
+    inline size_t size() const
+    {
+        return m_list.size();
+    }
+
+    void remove(const K &key)
+    {
+        auto it = m_map.find(key);
+        if (it == m_map.end())
+            return;
+
+        if (m_onEvict)
+            m_onEvict(it->second.value);
+
+        m_weight -= it->second.weight;
+        m_list.erase(it->second.it);
+        m_map.erase(it);
+    }
+
+    // Removes every entry whose key satisfies pred
+    template <typename Pred> void removeIf(Pred pred)
+    {
+        for (auto it = m_list.begin(); it != m_list.end();)
+        {
+            if (!pred(*it))
+            {
+                ++it;
+                continue;
+            }
+
+            auto entry = m_map.find(*it);
+            if (m_onEvict)
+                m_onEvict(entry->second.value);
+
+            m_weight -= entry->second.weight;
+            m_map.erase(entry);
+            it = m_list.erase(it);
+        }
+    }
+
+    void clear()
+    {
+        if (m_onEvict)
+        {
+            for (auto &entry : m_map)
+                m_onEvict(entry.second.value);
+        }
+
+        m_map.clear();
+        m_list.clear();
+        m_weight = 0;
+    }
+
+private:
+    struct Entry
+    {
+        V value;
+        size_t weight;
+        typename std::list<K>::iterator it;
+    };
+
+    // Evicts least recently used entries until both the entry count and the
+    // weight fit. The most recent entry is always kept, even if it alone is
+    // heavier than the budget.
+    void trim() noexcept
+    {
+        while (m_list.size() > 1
+               && (m_list.size() > m_capacity || m_weight > m_max_weight))
+            evict();
+    }
+
+    void evict() noexcept
+    {
+        if (m_list.empty())
+            return;
+
+        K lastKey = m_list.back();
+        auto it   = m_map.find(lastKey);
+
+        if (m_onEvict)
+            m_onEvict(it->second.value);
+
+        m_weight -= it->second.weight;
+        m_map.erase(it);
+        m_list.pop_back();
+    }
+
+    size_t m_capacity{0};
+    size_t m_max_weight{std::numeric_limits<size_t>::max()};
+    size_t m_weight{0};
+    std::list<K> m_list;
+    std::unordered_map<K, Entry, Hash> m_map;
+    EvictCallback m_onEvict;
+};
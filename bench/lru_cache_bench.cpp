@@ -0,0 +1,177 @@
+// LRUCache against the list and unordered_map cache it replaced, on access
+// patterns of the page, text and render caches. Prints ns per operation.
+//
+//   lru_cache_bench [operations]
+
+#include "LRUCache.hpp"
+#include "LegacyLRUCache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+// Cached values are refcounted handles (QImage, shared_ptr), copying one is
+// cheap but not free
+using Value = std::shared_ptr<int>;
+
+// Shaped like Model::RenderCacheKey: a page, its zoom and rotation, a tile
+struct TileKey
+{
+    int pageno;
+    double zoom;
+    int rotation;
+    int tile_x;
+    int tile_y;
+
+    bool operator==(const TileKey &) const = default;
+};
+
+struct TileKeyHash
+{
+    size_t operator()(const TileKey &key) const noexcept
+    {
+        size_t h = std::hash<int>{}(key.pageno);
+        for (const size_t v :
+             {std::hash<double>{}(key.zoom), std::hash<int>{}(key.rotation),
+              std::hash<int>{}(key.tile_x), std::hash<int>{}(key.tile_y)})
+            h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+TileKey
+tileKey(uint32_t i)
+{
+    return {static_cast<int>(i / 16), 1.5, 0, static_cast<int>(i % 4),
+            static_cast<int>(i / 4 % 4)};
+}
+
+// Key sequences, as indices into the key space
+//   scroll: pages around a position that drifts forward, mostly hits
+//   churn:  a window sliding over many more keys than fit, mostly misses
+//   skewed: a few hot pages among many, as with jumping between marks
+std::vector<uint32_t>
+scrollPattern(size_t ops, std::mt19937 &rng)
+{
+    std::vector<uint32_t> keys(ops);
+    for (size_t i = 0; i < ops; ++i)
+        keys[i] = static_cast<uint32_t>(i / 64 + rng() % 24);
+    return keys;
+}
+
+std::vector<uint32_t>
+churnPattern(size_t ops, std::mt19937 &)
+{
+    std::vector<uint32_t> keys(ops);
+    for (size_t i = 0; i < ops; ++i)
+        keys[i] = static_cast<uint32_t>(i % 4096);
+    return keys;
+}
+
+std::vector<uint32_t>
+skewedPattern(size_t ops, std::mt19937 &rng)
+{
+    std::vector<uint32_t> keys(ops);
+    for (size_t i = 0; i < ops; ++i)
+        keys[i] = rng() % 4 != 0 ? rng() % 16 : rng() % 2048;
+    return keys;
+}
+
+// Looks up every key and puts it on a miss, the way the caches are used.
+// Returns ns per operation and counts the hits.
+template <typename Cache, typename MakeKey>
+double
+run(const std::vector<uint32_t> &keys, size_t capacity, MakeKey makeKey,
+    size_t &hits)
+{
+    Cache cache;
+    cache.setCapacity(capacity);
+    const Value value = std::make_shared<int>(0);
+
+    hits             = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const uint32_t k : keys)
+    {
+        const auto key = makeKey(k);
+        if (cache.get(key))
+            ++hits;
+        else
+            cache.put(key, value);
+    }
+    const double s = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    return s * 1e9 / keys.size();
+}
+
+template <typename Cache, typename MakeKey>
+double
+bestOf(const std::vector<uint32_t> &keys, size_t capacity, MakeKey makeKey,
+       size_t &hits)
+{
+    constexpr int RUNS = 3;
+    double best        = run<Cache>(keys, capacity, makeKey, hits);
+    for (int i = 1; i < RUNS; ++i)
+        best = std::min(best, run<Cache>(keys, capacity, makeKey, hits));
+    return best;
+}
+
+template <typename K, typename Hash, typename MakeKey>
+bool
+compare(const char *name, const std::vector<uint32_t> &keys, size_t capacity,
+        MakeKey makeKey)
+{
+    size_t old_hits = 0, new_hits = 0;
+    const double old_ns = bestOf<LegacyLRUCache<K, Value, Hash>>(
+        keys, capacity, makeKey, old_hits);
+    const double new_ns
+        = bestOf<LRUCache<K, Value, Hash>>(keys, capacity, makeKey, new_hits);
+
+    std::printf("%-16s %8zu %7.1f%% %9.1f %9.1f\n", name, capacity,
+                100.0 * new_hits / keys.size(), old_ns, new_ns);
+
+    // Both evict the least recently used entry, so they must agree
+    if (old_hits != new_hits)
+    {
+        std::fprintf(stderr, "%s: hits differ (%zu vs %zu)\n", name, old_hits,
+                     new_hits);
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+    const size_t ops
+        = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : size_t{4000000};
+    std::mt19937 rng(42);
+
+    const std::vector<uint32_t> scroll = scrollPattern(ops, rng);
+    const std::vector<uint32_t> churn  = churnPattern(ops, rng);
+    const std::vector<uint32_t> skewed = skewedPattern(ops, rng);
+
+    const auto intKey = [](uint32_t k) { return static_cast<int>(k); };
+
+    std::printf("%zu operations, get() then put() on a miss\n\n", ops);
+    std::printf("%-16s %8s %8s %9s %9s\n", "pattern", "capacity", "hits",
+                "old ns", "new ns");
+
+    bool ok = true;
+    ok &= compare<int, std::hash<int>>("scroll int", scroll, 32, intKey);
+    ok &= compare<int, std::hash<int>>("churn int", churn, 256, intKey);
+    ok &= compare<int, std::hash<int>>("skewed int", skewed, 64, intKey);
+    ok &= compare<TileKey, TileKeyHash>("scroll tile", scroll, 32, tileKey);
+    ok &= compare<TileKey, TileKeyHash>("churn tile", churn, 256, tileKey);
+    ok &= compare<TileKey, TileKeyHash>("skewed tile", skewed, 64, tileKey);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Cost of the page color post-processing per megapixel, for every kernel the
+// CPU supports, on a generated page.
+//
+//   pixel_transform_bench [megapixels]
+
+// The kernels are only defined in the translation unit, it is compiled here
+// instead of being linked
+#include "PixelTransform.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+struct NamedKernel
+{
+    PixelTransform::Kernel::Fn fn;
+    const char *name;
+};
+
+std::vector<NamedKernel>
+supportedKernels()
+{
+    std::vector<NamedKernel> kernels{{PixelTransform::Kernel::scalar,
+                                      "scalar"}};
+#ifdef PIXEL_TRANSFORM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1"))
+        kernels.push_back({PixelTransform::Kernel::sse41, "sse4.1"});
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({PixelTransform::Kernel::avx2, "avx2"});
+#endif
+    return kernels;
+}
+
+// Mostly white with runs of dark text and a few colored blocks, like a
+// rendered page
+std::vector<unsigned char>
+makePage(size_t pixels)
+{
+    std::mt19937 rng(42);
+    std::vector<unsigned char> page(pixels * 4);
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        unsigned char *p = &page[i * 4];
+        const unsigned r = rng() % 100;
+        const unsigned char v
+            = r < 80 ? 255 : static_cast<unsigned char>(rng() % 256);
+        p[0] = v;
+        p[1] = r < 95 ? v : static_cast<unsigned char>(rng() % 256);
+        p[2] = r < 95 ? v : static_cast<unsigned char>(rng() % 256);
+        p[3] = 255;
+    }
+    return page;
+}
+
+// Best of a few runs, each on a fresh copy of the page
+double
+bestSeconds(const NamedKernel &kernel, const PixelTransform &t,
+            const std::vector<unsigned char> &page,
+            std::vector<unsigned char> &out)
+{
+    constexpr int RUNS = 5;
+    double best        = 0;
+    for (int i = 0; i < RUNS; ++i)
+    {
+        std::memcpy(out.data(), page.data(), page.size());
+        const auto start = std::chrono::steady_clock::now();
+        kernel.fn(t, out.data(), page.size() / 4);
+        const double s = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        if (i == 0 || s < best)
+            best = s;
+    }
+    return best;
+}
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+    const double mp = argc > 1 ? std::strtod(argv[1], nullptr) : 8.0;
+    const size_t pixels = static_cast<size_t>(mp * 1e6);
+    if (pixels == 0)
+        return 1;
+
+    const std::vector<unsigned char> page = makePage(pixels);
+    std::vector<unsigned char> out(page.size()), reference(page.size());
+
+    struct Case
+    {
+        const char *name;
+        PixelTransform transform;
+    };
+    const Case cases[] = {
+        {"tint", PixelTransform(0xE0E0E0, 0x202020, false, 1.0f)},
+        {"invert", PixelTransform(0x000000, 0xFFFFFF, true, 1.0f)},
+        {"gamma", PixelTransform(0x000000, 0xFFFFFF, false, 1.8f)},
+        {"tint+invert+gamma", PixelTransform(0x101820, 0xF0E8D0, true, 1.4f)},
+    };
+
+    const std::vector<NamedKernel> kernels = supportedKernels();
+
+    std::printf("page %.1f MP, apply() uses %s\n\n", mp,
+                PixelTransform::kernelName());
+    std::printf("%-20s", "ms per megapixel");
+    for (const NamedKernel &kernel : kernels)
+        std::printf(" %9s", kernel.name);
+    std::printf("\n");
+
+    for (const Case &c : cases)
+    {
+        std::printf("%-20s", c.name);
+        for (size_t k = 0; k < kernels.size(); ++k)
+        {
+            const double s = bestSeconds(kernels[k], c.transform, page, out);
+            std::printf(" %9.3f", s * 1e3 / mp);
+
+            // Every kernel must give the bytes of the scalar one
+            if (k == 0)
+                reference = out;
+            else if (out != reference)
+            {
+                std::fprintf(stderr, "\n%s: %s differs from scalar\n", c.name,
+                             kernels[k].name);
+                return 1;
+            }
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
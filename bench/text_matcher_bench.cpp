@@ -0,0 +1,185 @@
+// Search throughput of TextMatcher::findAll against the loop it replaced,
+// on a generated corpus. Prints MB/s of UTF-16 text scanned.
+//
+//   text_matcher_bench [corpus MB]
+
+#include "TextMatcher.hpp"
+
+extern "C"
+{
+#include <mupdf/fitz.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+// The search loop before TextMatcher: every position compared character by
+// character, folding both sides of every comparison when case-insensitive
+inline bool
+charEqual(uint32_t a, uint32_t b, bool caseSensitive)
+{
+    if (caseSensitive)
+        return a == b;
+
+    return fz_tolower(a) == fz_tolower(b);
+}
+
+void
+oldFindAll(const std::u16string &text, const std::u16string &term,
+           bool caseSensitive, std::vector<uint32_t> &out)
+{
+    const int n = text.size();
+    const int m = term.size();
+
+    if (n < m)
+        return;
+
+    std::vector<uint32_t> pattern;
+    pattern.reserve(m);
+    for (char16_t c : term)
+        pattern.push_back(c);
+
+    for (int i = 0; i <= n - m; ++i)
+    {
+        bool match = true;
+
+        for (int j = 0; j < m; ++j)
+        {
+            if (!charEqual(text[i + j], pattern[j], caseSensitive))
+            {
+                match = false;
+                break;
+            }
+        }
+
+        if (match)
+            out.push_back(i);
+    }
+}
+
+// Words of mixed case and length separated by spaces and line breaks, close
+// enough to extracted page text for the first code unit filter to matter
+std::u16string
+makeCorpus(size_t units)
+{
+    static const char16_t *const words[] = {
+        u"the",      u"of",        u"and",       u"Register", u"interface",
+        u"a",        u"value",     u"is",        u"Section",  u"memory",
+        u"returns",  u"THE",       u"page",      u"which",    u"regular",
+        u"document", u"Figure",    u"in",        u"between",  u"e",
+        u"vector",   u"structure", u"to",        u"Table",    u"expression",
+        u"for",      u"matching",  u"results",   u"with",     u"\u00e9t\u00e9"};
+    constexpr size_t word_count = sizeof(words) / sizeof(words[0]);
+
+    std::mt19937 rng(42);
+    std::u16string text;
+    text.reserve(units + 32);
+    while (text.size() < units)
+    {
+        text += words[rng() % word_count];
+        text += rng() % 12 == 0 ? u'\n' : u' ';
+    }
+    text.resize(units);
+    return text;
+}
+
+std::u16string
+u16(const char *s)
+{
+    std::u16string out;
+    for (; *s; ++s)
+        out += static_cast<char16_t>(*s);
+    return out;
+}
+
+template <typename F>
+double
+secondsOf(F &&f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start)
+        .count();
+}
+
+// Best of a few runs, the first one also warms the caches
+template <typename F>
+double
+bestOf(int runs, F &&f)
+{
+    double best = secondsOf(f);
+    for (int i = 1; i < runs; ++i)
+        best = std::min(best, secondsOf(f));
+    return best;
+}
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+    const size_t mb    = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    const size_t units = mb * 1024 * 1024 / sizeof(char16_t);
+    const double bytes = units * sizeof(char16_t);
+    constexpr int RUNS = 3;
+
+    const std::u16string text = makeCorpus(units);
+
+    std::u16string folded;
+    const double fold_s
+        = bestOf(RUNS, [&]() { folded = TextMatcher::fold(text); });
+
+    std::printf("corpus %zu MB, kernel %s\n", mb, TextMatcher::kernelName());
+    std::printf("fold (once per page) %8.0f MB/s\n\n", bytes / fold_s / 1e6);
+    std::printf("%-28s %5s %10s %10s %10s\n", "pattern", "case", "matches",
+                "old MB/s", "new MB/s");
+
+    const char *const patterns[]
+        = {"e", "reg", "interface", "zq", "regular expression matching"};
+
+    for (const char *p : patterns)
+    {
+        for (const bool case_sensitive : {false, true})
+        {
+            const std::u16string term = u16(p);
+            std::vector<uint32_t> old_hits, new_hits;
+
+            const double old_s = bestOf(RUNS, [&]()
+            {
+                old_hits.clear();
+                oldFindAll(text, term, case_sensitive, old_hits);
+            });
+
+            // As in Model::runSearch(), the matcher is built once per search
+            // and case-insensitive searches scan the folded copy
+            const double new_s = bestOf(RUNS, [&]()
+            {
+                new_hits.clear();
+                const TextMatcher matcher(
+                    case_sensitive ? term : TextMatcher::fold(term));
+                matcher.findAll(case_sensitive ? text : folded, new_hits);
+            });
+
+            if (old_hits != new_hits)
+            {
+                std::fprintf(stderr, "'%s': results differ (%zu vs %zu)\n", p,
+                             old_hits.size(), new_hits.size());
+                return 1;
+            }
+
+            std::printf("%-28s %5s %10zu %10.0f %10.0f\n", p,
+                        case_sensitive ? "yes" : "no", new_hits.size(),
+                        bytes / old_s / 1e6, bytes / new_s / 1e6);
+        }
+    }
+
+    return 0;
+}
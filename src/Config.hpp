@@ -166,6 +166,12 @@ struct Config
         float inv_dpr{1.0f};
         bool icc_color_profile{true};
         int antialiasing_bits{8};
+        int max_concurrent_renders{4}; // 0 = one per core
+        int render_cache_mb{256};      // 0 = disabled
+        int page_cache_mb{128};        // 0 = limit by behavior.cache_pages
+        int memory_limit_mb{1024};     // all open documents, 0 = no limit
+        int tile_threshold_mp{8};      // 0 = never tile
+        float preview_scale{0.25f};    // 0 = no preview pass
     };
 
     struct behavior
@@ -179,6 +185,7 @@ struct Config
         bool always_open_in_new_window{false};
         bool remember_last_visited{true};
         bool recent_files{true};
+        bool search_index{true};
         int page_history_limit{5};
         int num_recent_files{10};
         int startpage_override{-1};
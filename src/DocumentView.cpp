@@ -7,6 +7,7 @@
 #include "GraphicsPixmapItem.hpp"
 #include "GraphicsView.hpp"
 #include "LinkHint.hpp"
+#include "MemoryGovernor.hpp"
 #include "PropertiesWidget.hpp"
 #include "WaitingSpinnerWidget.hpp"
 #include "commands/DeleteAnnotationsCommand.hpp"
@@ -27,12 +28,15 @@
 #include <QPainter>
 #include <QProcess>
 #include <QTextCursor>
+#include <QThread>
 #include <QTransform>
 #include <QUrl>
 #include <QVBoxLayout>
 #include <QtConcurrent/QtConcurrent>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <optional>
 #include <qdebug.h>
 #include <qguiapplication.h>
 #include <qicon.h>
@@ -132,8 +136,9 @@ DocumentView::initGui() noexcept
         rgbaToQColor(m_config.ui.colors.annot_rect).toRgb());
     m_model->setSelectionColor(rgbaToQColor(m_config.ui.colors.selection));
     m_model->setHighlightColor(rgbaToQColor(m_config.ui.colors.highlight));
-    // m_model->setAntialiasingBits(m_config.rendering.antialiasing_bits);
+    m_model->setAntialiasingBits(m_config.rendering.antialiasing_bits);
     m_model->undoStack()->setUndoLimit(m_config.behavior.undo_limit);
+    m_model->setTextIndexEnabled(m_config.behavior.search_index);
 
     m_model->setInvertColor(m_config.behavior.invert_mode);
     m_model->setLinkBoundary(m_config.ui.links.boundary);
@@ -141,7 +146,33 @@ DocumentView::initGui() noexcept
     m_model->setUrlLinkRegex(m_config.ui.links.url_regex);
     // if (m_config.rendering.icc_color_profile)
     //     m_model->enableICC();
-    m_model->setCacheCapacity(m_config.behavior.cache_pages);
+    // With a byte budget it alone limits the page cache, so documents made of
+    // light pages keep all of them. cache_pages then only sizes the preload
+    // margin.
+    const size_t pageCacheBytes
+        = static_cast<size_t>(std::max(0, m_config.rendering.page_cache_mb))
+          << 20;
+    m_model->setCacheCapacity(
+        pageCacheBytes > 0 ? std::numeric_limits<int>::max()
+                           : std::max(0, m_config.behavior.cache_pages));
+    m_model->setPageCacheBudget(pageCacheBytes);
+    MemoryGovernor::instance().setLimit(
+        static_cast<size_t>(std::max(0, m_config.rendering.memory_limit_mb))
+        << 20);
+    m_model->setRenderCacheBudget(
+        static_cast<size_t>(std::max(0, m_config.rendering.render_cache_mb))
+        << 20);
+    m_tile_threshold
+        = static_cast<qint64>(std::max(0, m_config.rendering.tile_threshold_mp))
+          * 1000000;
+    m_preview_scale = std::clamp(m_config.rendering.preview_scale, 0.0f, 1.0f);
+
+    // 0 (or less) means one render per core
+    const int cores = std::max(1, QThread::idealThreadCount());
+    const int maxRenders = m_config.rendering.max_concurrent_renders;
+    m_max_concurrent_renders
+        = maxRenders > 0 ? std::min(maxRenders, cores) : cores;
+    m_model->setMaxConcurrentRenders(m_max_concurrent_renders);
     m_model->setBackgroundColor(m_config.ui.colors.page_background);
     m_model->setForegroundColor(m_config.ui.colors.page_foreground);
 
@@ -398,6 +429,10 @@ DocumentView::initConnections() noexcept
     // });
     connect(m_model, &Model::searchResultsReady, this,
             &DocumentView::handleSearchResults);
+    connect(m_model, &Model::searchFinished, this,
+            &DocumentView::handleSearchFinished);
+    connect(m_model, &Model::searchFailed, this,
+            &DocumentView::handleSearchFailed);
 
     connect(m_model, &Model::reloadRequested, this, &DocumentView::reloadPage);
 
@@ -413,9 +448,19 @@ DocumentView::initConnections() noexcept
         connect(m_hscroll, &QScrollBar::valueChanged, this,
                 &DocumentView::updateCurrentPage);
 
+        connect(m_hscroll, &QScrollBar::valueChanged, this,
+                &DocumentView::trackScrollMotion);
+
         connect(m_hq_render_timer, &QTimer::timeout, this,
                 &DocumentView::renderVisiblePages);
 
+        // The user paused, preload evenly around the view again
+        connect(m_scroll_page_update_timer, &QTimer::timeout, this, [this]()
+        {
+            m_scroll_velocity = 0.0;
+            invalidateVisiblePagesCache();
+        });
+
         connect(m_scroll_page_update_timer, &QTimer::timeout, this,
                 &DocumentView::renderVisiblePages);
     }
@@ -431,9 +476,19 @@ DocumentView::initConnections() noexcept
         connect(m_vscroll, &QScrollBar::valueChanged, this,
                 &DocumentView::updateCurrentPage);
 
+        connect(m_vscroll, &QScrollBar::valueChanged, this,
+                &DocumentView::trackScrollMotion);
+
         connect(m_hq_render_timer, &QTimer::timeout, this,
                 &DocumentView::renderVisiblePages);
 
+        // The user paused, preload evenly around the view again
+        connect(m_scroll_page_update_timer, &QTimer::timeout, this, [this]()
+        {
+            m_scroll_velocity = 0.0;
+            invalidateVisiblePagesCache();
+        });
+
         connect(m_scroll_page_update_timer, &QTimer::timeout, this,
                 &DocumentView::renderVisiblePages);
     }
@@ -487,6 +542,8 @@ DocumentView::initConnections() noexcept
             &DocumentView::handleAnnotPopupRequested);
 }
 
+// A batch of hits from a running search, pages nearest to where the search
+// started come first
 void
 DocumentView::handleSearchResults(
     const QMap<int, std::vector<Model::SearchHit>> &results) noexcept
@@ -496,28 +553,80 @@ DocumentView::handleSearchResults(
              << results.size() << "pages with search hits.";
 #endif
 
-    emit searchBarSpinnerShow(false);
-    // Clear previous search hits
-    clearSearchHits();
-
     if (results.isEmpty())
-    {
-        QMessageBox::information(this, tr("Search"),
-                                 tr("No matches found for "
-                                    "the given term."));
         return;
-    }
 
-    m_search_hits = results;
+    const bool first_batch = m_search_hits.isEmpty();
+
+    // Batches arrive out of page order, keep the current hit selected while
+    // the flat index grows around it
+    const std::optional<HitRef> current
+        = m_search_index >= 0 && m_search_index < m_search_hit_flat_refs.size()
+              ? std::optional<HitRef>(m_search_hit_flat_refs[m_search_index])
+              : std::nullopt;
+
+    m_search_hits.insert(results);
     buildFlatSearchHitIndex();
-    renderVisiblePages();
-    updateCurrentHitHighlight();
+
+    if (current)
+    {
+        const auto it = std::lower_bound(
+            m_search_hit_flat_refs.cbegin(), m_search_hit_flat_refs.cend(),
+            *current, [](const HitRef &a, const HitRef &b)
+        {
+            return a.page < b.page
+                   || (a.page == b.page && a.indexInPage < b.indexInPage);
+        });
+        m_search_index = it - m_search_hit_flat_refs.cbegin();
+    }
+
+    for (auto it = results.constBegin(); it != results.constEnd(); ++it)
+    {
+        if (m_page_items_hash.contains(it.key()))
+            renderSearchHitsForPage(it.key());
+    }
 
     if (m_config.ui.scrollbars.search_hits)
         renderSearchHitsInScrollbar();
-    emit searchCountChanged(m_model->searchMatchesCount());
+    emit searchCountChanged(static_cast<int>(m_search_hit_flat_refs.size()));
 
-    GotoHit(0);
+    if (first_batch)
+    {
+        // The first batch holds the hits nearest to the current page, jump
+        // to the first one at or after it
+        const auto it = std::find_if(m_search_hit_flat_refs.cbegin(),
+                                     m_search_hit_flat_refs.cend(),
+                                     [this](const HitRef &ref)
+        { return ref.page >= m_pageno; });
+        GotoHit(it != m_search_hit_flat_refs.cend()
+                    ? it - m_search_hit_flat_refs.cbegin()
+                    : 0);
+    }
+    else
+    {
+        emit searchIndexChanged(m_search_index);
+    }
+}
+
+void
+DocumentView::handleSearchFinished(int matchCount) noexcept
+{
+    emit searchBarSpinnerShow(false);
+
+    if (matchCount == 0 && m_search_hits.isEmpty())
+    {
+        QMessageBox::information(this, tr("Search"),
+                                 tr("No matches found for "
+                                    "the given term."));
+    }
+}
+
+void
+DocumentView::handleSearchFailed(const QString &error) noexcept
+{
+    emit searchBarSpinnerShow(false);
+    QMessageBox::warning(this, tr("Search"),
+                         tr("Invalid regular expression: %1").arg(error));
 }
 
 void
@@ -750,9 +859,10 @@ DocumentView::rotateHelper() noexcept
 {
     cachePageStride();
     const std::set<int> &trackedPages = getVisiblePages();
+    // Display lists are resolution and rotation independent, only the
+    // rasterization (and the scene items placed from it) has to be redone
     for (int pageno : trackedPages)
     {
-        m_model->invalidatePageCache(pageno);
         clearLinksForPage(pageno);
         clearAnnotationsForPage(pageno);
         clearSearchItemsForPage(pageno);
@@ -1038,7 +1148,8 @@ DocumentView::clearSearchHits() noexcept
 
 // Perform search for the given term
 void
-DocumentView::Search(const QString &term) noexcept
+DocumentView::Search(const QString &term,
+                     SearchQuery::Options options) noexcept
 {
 #ifndef NDEBUG
     qDebug() << "DocumentView::Search(): Searching for term:" << term;
@@ -1047,17 +1158,18 @@ DocumentView::Search(const QString &term) noexcept
     clearSearchHits();
     if (term.isEmpty())
     {
+        m_model->cancelSearch();
+        emit searchBarSpinnerShow(false);
         m_current_search_hit_item->setPath(QPainterPath());
         return;
     }
 
     emit searchBarSpinnerShow(true);
-    // Check if term has atleast one uppercase letter
-    bool caseSensitive = std::any_of(term.cbegin(), term.cend(),
-                                     [](QChar c) { return c.isUpper(); });
+    options.case_sensitive
+        = SearchQuery::isSmartCaseSensitive(term, options.regex);
 
     // m_search_hits = m_model->search(term);
-    m_model->search(term, caseSensitive);
+    m_model->search(term, options, m_pageno);
 }
 
 // Function that is common to zoom-in and zoom-out
@@ -1127,12 +1239,13 @@ DocumentView::zoomHelper() noexcept
         }
         else
         {
-            // Calculate scale based on ACTUAL pixmap height vs TARGET pixel
-            // height This ensures the item perfectly fills the 'pixelHeight'
-            // portion of the stride
-            double currentPixmapHeight = item->pixmap().height();
-            double perfectScale
-                = static_cast<double>(targetPixelHeight) / currentPixmapHeight;
+            // Calculate scale based on the item's logical height vs TARGET
+            // pixel height This ensures the item perfectly fills the
+            // 'pixelHeight' portion of the stride. The logical height does
+            // not depend on the resolution the page was rasterized at.
+            const double currentLogicalHeight = item->boundingRect().height();
+            double perfectScale = static_cast<double>(targetPixelHeight)
+                                  / m_model->DPR() / currentLogicalHeight;
             item->setScale(perfectScale);
 
             pageWidthScene  = item->boundingRect().width() * item->scale();
@@ -1160,10 +1273,10 @@ DocumentView::zoomHelper() noexcept
 
     m_model->setZoom(m_current_zoom);
 
+    // Keep the cached display lists, they are valid at any zoom level
     QList<int> trackedPages = m_page_links_hash.keys();
     for (int pageno : trackedPages)
     {
-        m_model->invalidatePageCache(pageno);
         clearLinksForPage(pageno);
         clearAnnotationsForPage(pageno);
         clearSearchItemsForPage(pageno);
@@ -1781,8 +1894,24 @@ DocumentView::getVisiblePages() noexcept
         a1 = visibleSceneRect.bottom();
     }
 
-    a0 -= m_preload_margin;
-    a1 += m_preload_margin;
+    // Symmetric preload at rest. When moving, up to 90% of the same total
+    // margin goes ahead of the view.
+    const double speed  = std::abs(m_scroll_velocity) / m_page_stride;
+    const double bias
+        = 0.4 * std::min(1.0, speed / FAST_SCROLL_PAGES_PER_SEC);
+    const double ahead  = 2.0 * m_preload_margin * (0.5 + bias);
+    const double behind = 2.0 * m_preload_margin * (0.5 - bias);
+
+    if (m_scroll_velocity < 0)
+    {
+        a0 -= ahead;
+        a1 += behind;
+    }
+    else
+    {
+        a0 -= behind;
+        a1 += ahead;
+    }
 
     int firstPage = static_cast<int>(std::floor(a0 / m_page_stride));
     int lastPage  = static_cast<int>(std::floor(a1 / m_page_stride));
@@ -1797,6 +1926,65 @@ DocumentView::getVisiblePages() noexcept
     return m_visible_pages_cache;
 }
 
+// Measures which way and how fast the user is moving. Preloading leans
+// towards the direction of travel, and the visible pages are re-evaluated
+// periodically during long scrolls instead of only once the user pauses.
+void
+DocumentView::trackScrollMotion(int value) noexcept
+{
+    const int delta     = value - m_last_scroll_value;
+    m_last_scroll_value = value;
+
+    if (delta > 0)
+        m_scroll_direction = 1;
+    else if (delta < 0)
+        m_scroll_direction = -1;
+
+    qint64 dt = -1;
+    if (m_scroll_clock.isValid())
+        dt = m_scroll_clock.restart();
+    else
+        m_scroll_clock.start();
+
+    // A gap longer than the settle timeout starts a new movement, single
+    // jumps (go to page, zoom) never count as scrolling
+    if (dt > 0 && dt < m_scroll_page_update_timer->interval())
+    {
+        const double instant = delta * 1000.0 / static_cast<double>(dt);
+        m_scroll_velocity    = 0.5 * m_scroll_velocity + 0.5 * instant;
+    }
+    else
+    {
+        m_scroll_velocity = 0.0;
+        return;
+    }
+
+    if (!m_render_pass_clock.isValid()
+        || m_render_pass_clock.elapsed() >= SCROLL_RENDER_INTERVAL_MS)
+        renderVisiblePages();
+}
+
+// Whether the page will have scrolled out of view before a render started
+// now could finish
+bool
+DocumentView::isPassedBeforeRendered(int pageno,
+                                     const QRectF &viewRect) const noexcept
+{
+    if (m_scroll_velocity == 0.0 || m_layout_mode == LayoutMode::SINGLE)
+        return false;
+
+    const bool horizontal = m_layout_mode == LayoutMode::LEFT_TO_RIGHT;
+    const double v0       = horizontal ? viewRect.left() : viewRect.top();
+    const double v1       = horizontal ? viewRect.right() : viewRect.bottom();
+    const double p0       = pageno * m_page_stride;
+    const double p1       = p0 + m_page_stride;
+
+    // Distance the view travels until the page is entirely behind it
+    const double distance = m_scroll_velocity > 0 ? p1 - v0 : v1 - p0;
+    const double exitMs = distance / std::abs(m_scroll_velocity) * 1000.0;
+    return exitMs < m_avg_render_ms;
+}
+
 void
 DocumentView::invalidateVisiblePagesCache() noexcept
 {
@@ -1866,6 +2054,11 @@ DocumentView::clearAnnotationsForPage(int pageno) noexcept
 void
 DocumentView::renderVisiblePages() noexcept
 {
+    // Nothing to render from until the tab is shown again
+    if (m_suspended)
+        return;
+
+    m_render_pass_clock.start();
     std::set<int> visiblePages = getVisiblePages();
 
     prunePendingRenders(visiblePages);
@@ -1873,7 +2066,11 @@ DocumentView::renderVisiblePages() noexcept
     // ClearTextSelection();
 
     for (int pageno : visiblePages)
+    {
         requestPageRender(pageno);
+        requestPageTiles(pageno);
+    }
+    startNextRenderJob();
 
     updateSceneRect();
     updateCurrentHitHighlight();
@@ -1886,6 +2083,8 @@ DocumentView::renderPage() noexcept
     prunePendingRenders({m_pageno});
     removeUnusedPageItems({m_pageno});
     requestPageRender(m_pageno);
+    requestPageTiles(m_pageno);
+    startNextRenderJob();
 
     updateSceneRect();
     updateCurrentHitHighlight();
@@ -1894,19 +2093,55 @@ DocumentView::renderPage() noexcept
 void
 DocumentView::prunePendingRenders(const std::set<int> &visiblePages) noexcept
 {
-    if (m_pending_renders.isEmpty() && m_render_queue.isEmpty())
+    if (m_pending_renders.isEmpty() && m_pending_tiles.isEmpty()
+        && m_pending_previews.isEmpty())
         return;
 
     QSet<int> visibleSet;
     for (int pageno : visiblePages)
         visibleSet.insert(pageno);
 
-    const int inFlightPage = m_render_in_flight ? m_render_in_flight_page : -1;
+    // Stop workers busy with pages that left the visible set, their
+    // callbacks clean up the bookkeeping below
+    for (auto it = m_previews_in_flight.cbegin();
+         it != m_previews_in_flight.cend(); ++it)
+    {
+        if (!visibleSet.contains(it.key()))
+            it.value()->abort = 1;
+    }
+    for (auto it = m_renders_in_flight.cbegin();
+         it != m_renders_in_flight.cend(); ++it)
+    {
+        if (!visibleSet.contains(it.key()))
+            it.value()->abort = 1;
+    }
+    for (auto it = m_tiles_in_flight.cbegin(); it != m_tiles_in_flight.cend();
+         ++it)
+    {
+        if (!visibleSet.contains(it.key().pageno))
+            it.value()->abort = 1;
+    }
+
+    for (auto it = m_pending_previews.begin(); it != m_pending_previews.end();)
+    {
+        if (m_previews_in_flight.contains(*it) || visibleSet.contains(*it))
+            ++it;
+        else
+            it = m_pending_previews.erase(it);
+    }
+
+    for (auto it = m_pending_tiles.begin(); it != m_pending_tiles.end();)
+    {
+        if (m_tiles_in_flight.contains(*it) || visibleSet.contains(it->pageno))
+            ++it;
+        else
+            it = m_pending_tiles.erase(it);
+    }
 
     for (auto it = m_pending_renders.begin(); it != m_pending_renders.end();)
     {
         const int pageno = *it;
-        if (pageno == inFlightPage || visibleSet.contains(pageno))
+        if (m_renders_in_flight.contains(pageno) || visibleSet.contains(pageno))
         {
             ++it;
         }
@@ -1915,25 +2150,19 @@ DocumentView::prunePendingRenders(const std::set<int> &visiblePages) noexcept
             it = m_pending_renders.erase(it);
         }
     }
-
-    if (m_render_queue.isEmpty())
-        return;
-
-    QQueue<int> filtered;
-    while (!m_render_queue.isEmpty())
-    {
-        const int pageno = m_render_queue.dequeue();
-        if (pageno == inFlightPage || visibleSet.contains(pageno))
-            filtered.enqueue(pageno);
-    }
-    m_render_queue = std::move(filtered);
 }
 
 void
 DocumentView::removeUnusedPageItems(const std::set<int> &visibleSet) noexcept
 {
-    // Copy keys first to avoid iterator invalidation
-    QList<int> trackedPages = m_page_links_hash.keys();
+    // Copy keys first to avoid iterator invalidation. Pages without links
+    // only have a page item, and their pixmaps (and tiles) must go too.
+    QSet<int> trackedPages(m_page_links_hash.keyBegin(),
+                           m_page_links_hash.keyEnd());
+    for (auto it = m_page_items_hash.keyBegin();
+         it != m_page_items_hash.keyEnd(); ++it)
+        trackedPages.insert(*it);
+
     for (int pageno : trackedPages)
     {
         if (visibleSet.find(pageno) == visibleSet.end())
@@ -2096,6 +2325,9 @@ DocumentView::showEvent(QShowEvent *event)
 {
     QWidget::showEvent(event);
 
+    resume();
+    MemoryGovernor::instance().touch(m_model);
+
     if (!m_deferred_fit)
         return;
 
@@ -2103,6 +2335,92 @@ DocumentView::showEvent(QShowEvent *event)
     m_deferred_fit = false;
 }
 
+bool
+DocumentView::suspend() noexcept
+{
+    // A search of all tabs would lose this one's results
+    if (m_suspended || m_is_modified || m_model->filePath().isEmpty()
+        || m_model->numPages() == 0 || m_model->passwordRequired()
+        || m_model->isDocumentSearchRunning())
+        return false;
+
+    QWidget *viewport = m_gview->viewport();
+    const QRectF sceneArea
+        = m_gview->mapToScene(viewport->rect()).boundingRect();
+    QPixmap shot(viewport->size() * SUSPEND_SNAPSHOT_SCALE);
+    shot.fill(m_gview->backgroundBrush().color());
+    {
+        QPainter painter(&shot);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        m_gscene->render(&painter, QRectF(shot.rect()), sceneArea);
+    }
+
+    m_suspend_snapshot.viewport      = std::move(shot);
+    m_suspend_snapshot.viewport_size = viewport->size();
+    m_suspend_snapshot.location      = CurrentLocation();
+
+    // The scene rect and scroll position stay, so resuming lands on the same
+    // spot without any layout work
+    clearDocumentItems();
+    m_model->suspend();
+    m_suspended = true;
+
+#ifndef NDEBUG
+    qDebug() << "DocumentView::suspend(): Suspended" << m_model->filePath();
+#endif
+    return true;
+}
+
+void
+DocumentView::resume() noexcept
+{
+    if (!m_suspended)
+        return;
+
+    m_suspended = false;
+
+    if (!m_snapshot_label)
+    {
+        m_snapshot_label = new QLabel(m_gview->viewport());
+        m_snapshot_label->setScaledContents(true);
+        m_snapshot_label->setAttribute(Qt::WA_TransparentForMouseEvents);
+    }
+    m_snapshot_label->setPixmap(m_suspend_snapshot.viewport);
+    m_snapshot_label->setGeometry(m_gview->viewport()->rect());
+    m_snapshot_label->show();
+    m_snapshot_label->raise();
+
+    if (!m_model->reloadDocument())
+    {
+        hideSuspendSnapshot();
+        QMessageBox::warning(this, "Resume tab",
+                             QString("Could not reopen %1")
+                                 .arg(m_model->filePath()));
+        return;
+    }
+
+    // The window was resized while the tab was away
+    if (m_gview->viewport()->size() != m_suspend_snapshot.viewport_size
+        && m_suspend_snapshot.location.pageno >= 0)
+        GotoLocation(m_suspend_snapshot.location);
+    else
+        renderVisiblePages();
+
+    // In case the visible pages never finish (e.g. a broken page)
+    QTimer::singleShot(1000, this, &DocumentView::hideSuspendSnapshot);
+}
+
+void
+DocumentView::hideSuspendSnapshot() noexcept
+{
+    if (!m_snapshot_label || m_snapshot_label->isHidden())
+        return;
+
+    m_snapshot_label->hide();
+    m_snapshot_label->clear();
+    m_suspend_snapshot = {};
+}
+
 // Check if a scene position is within any page item
 bool
 DocumentView::pageAtScenePos(const QPointF &scenePos, int &outPageIndex,
@@ -2367,6 +2685,10 @@ DocumentView::clearDocumentItems() noexcept
     invalidateVisiblePagesCache();
     for (QGraphicsItem *item : m_gscene->items())
     {
+        // Children (page tiles) are deleted along with their parent
+        if (item->parentItem())
+            continue;
+
         if (item != m_jump_marker && item != m_selection_path_item
             && item != m_current_search_hit_item)
         {
@@ -2380,13 +2702,26 @@ DocumentView::clearDocumentItems() noexcept
     m_search_items.clear();
     m_page_links_hash.clear();
     m_page_annotations_hash.clear();
+
+    // Late results are dropped by the epoch check, no need to finish them
+    for (const auto &cookie : std::as_const(m_renders_in_flight))
+        cookie->abort = 1;
+    for (const auto &cookie : std::as_const(m_previews_in_flight))
+        cookie->abort = 1;
+    for (const auto &cookie : std::as_const(m_tiles_in_flight))
+        cookie->abort = 1;
+
     m_pending_renders.clear();
-    m_render_queue.clear();
-    m_render_in_flight      = false;
-    m_render_in_flight_page = -1;
+    m_renders_in_flight.clear();
+    m_pending_tiles.clear();
+    m_tiles_in_flight.clear();
+    m_pending_previews.clear();
+    m_previews_in_flight.clear();
+    ++m_render_epoch;
 }
 
-// Request rendering of a specific page (ASYNC)
+// Request rendering of a specific page (ASYNC). Only marks it pending, call
+// startNextRenderJob once every request is in so they go out by priority.
 void
 DocumentView::requestPageRender(int pageno) noexcept
 {
@@ -2396,68 +2731,469 @@ DocumentView::requestPageRender(int pageno) noexcept
     if (m_pending_renders.contains(pageno))
         return;
 
+    // A finished render at the current parameters is reused as is
+    const Model::RenderJob job = pageRenderJob(pageno);
+    if (const Model::PageRenderResult *cached = m_model->cachedPageRender(job))
+    {
+        const Model::PageRenderResult result = *cached;
+        applyPageRenderResult(job, result);
+        return;
+    }
+
     m_pending_renders.insert(pageno);
     createAndAddPlaceholderPageItem(pageno);
 
-    m_render_queue.enqueue(pageno);
-    startNextRenderJob();
+    // Blank pages get a quick low resolution pass first, so fast scrolling
+    // shows content instead of white rectangles
+    if (!pageHasContent(pageno))
+        requestPagePreview(pageno);
 }
 
+// Lower is rendered first: pages intersecting the viewport by distance from
+// its center, then the preload pages ahead in the scroll direction, then the
+// ones behind. Evaluated at dispatch time, so the order always follows the
+// current scroll position.
+DocumentView::RenderPriority
+DocumentView::renderPriority(int pageno, const QRectF &viewRect) const noexcept
+{
+    if (m_layout_mode == LayoutMode::SINGLE)
+        return {pageno == m_pageno ? 0 : 1, 0.0};
+
+    const bool horizontal = m_layout_mode == LayoutMode::LEFT_TO_RIGHT;
+    const double v0 = horizontal ? viewRect.left() : viewRect.top();
+    const double v1 = horizontal ? viewRect.right() : viewRect.bottom();
+    const double p0 = pageno * m_page_stride;
+    const double p1 = p0 + m_page_stride;
+    const double distance = std::abs((p0 + p1) / 2.0 - (v0 + v1) / 2.0);
+
+    if (p1 > v0 && p0 < v1)
+        return {0, distance};
+
+    const int side = p0 >= v1 ? 1 : -1;
+    if (m_scroll_direction == 0 || side == m_scroll_direction)
+        return {1, distance};
+
+    return {2, distance};
+}
+
+// Dispatch pending jobs, most urgent first, until the render pool is
+// saturated. Results are delivered independently, in whatever order the
+// workers finish.
 void
 DocumentView::startNextRenderJob() noexcept
 {
-    if (m_render_in_flight)
-        return;
+    const auto inFlight = [this]()
+    {
+        return m_previews_in_flight.size() + m_renders_in_flight.size()
+               + m_tiles_in_flight.size();
+    };
 
-    while (!m_render_queue.isEmpty())
+    const QRectF viewRect
+        = m_gview->mapToScene(m_gview->viewport()->rect()).boundingRect();
+
+    const auto nextPage
+        = [this, &viewRect](
+              const QSet<int> &pending,
+              const QHash<int, std::shared_ptr<fz_cookie>> &running) -> int
     {
-        const int pageno = m_render_queue.dequeue();
-        if (!m_pending_renders.contains(pageno))
-            continue;
+        int best = -1;
+        RenderPriority bestPriority;
+        for (int pageno : pending)
+        {
+            // Left pending, picked up once the scrolling slows down
+            if (running.contains(pageno)
+                || isPassedBeforeRendered(pageno, viewRect))
+                continue;
+
+            const RenderPriority priority = renderPriority(pageno, viewRect);
+            if (best < 0 || priority < bestPriority)
+            {
+                best         = pageno;
+                bestPriority = priority;
+            }
+        }
+        return best;
+    };
+
+    // Previews are cheap and fill blank pages, they go first
+    while (inFlight() < m_max_concurrent_renders)
+    {
+        const int pageno = nextPage(m_pending_previews, m_previews_in_flight);
+        if (pageno < 0)
+            break;
 
-        m_render_in_flight      = true;
-        m_render_in_flight_page = pageno;
-        auto job                = m_model->createRenderJob(pageno);
+        const quint64 epoch = m_render_epoch;
+        auto job            = previewRenderJob(pageno);
+        job.cookie          = std::make_shared<fz_cookie>();
+        m_previews_in_flight.insert(pageno, job.cookie);
 
         m_model->requestPageRender(
-            job, [this, pageno](const Model::PageRenderResult &result)
+            job,
+            [this, pageno, epoch, job](const Model::PageRenderResult &result)
         {
+            if (epoch != m_render_epoch)
+                return;
+
+            m_pending_previews.remove(pageno);
+            m_previews_in_flight.remove(pageno);
+
+            // The full render may have won the race
+            const std::set<int> &visiblePages = getVisiblePages();
+            if (!result.image.isNull() && m_model->isRenderJobCurrent(job)
+                && visiblePages.find(pageno) != visiblePages.end()
+                && !pageHasContent(pageno))
+                renderPageFromImage(pageno, result.image);
+
+            startNextRenderJob();
+        });
+    }
+
+    while (inFlight() < m_max_concurrent_renders)
+    {
+        const int pageno = nextPage(m_pending_renders, m_renders_in_flight);
+        if (pageno < 0)
+            break;
+
+        const quint64 epoch = m_render_epoch;
+        auto job            = pageRenderJob(pageno);
+        job.cookie          = std::make_shared<fz_cookie>();
+        m_renders_in_flight.insert(pageno, job.cookie);
+
+        QElapsedTimer clock;
+        clock.start();
+
+        m_model->requestPageRender(
+            job, [this, pageno, epoch, job,
+                  clock](const Model::PageRenderResult &result)
+        {
+            // Scene was reset while this page was rendering
+            if (epoch != m_render_epoch)
+                return;
+
             m_pending_renders.remove(pageno);
-            m_render_in_flight      = false;
-            m_render_in_flight_page = -1;
+            m_renders_in_flight.remove(pageno);
+
+            // Feeds isPassedBeforeRendered
+            if (!job.cookie->abort && !result.image.isNull())
+                m_avg_render_ms = 0.8 * m_avg_render_ms + 0.2 * clock.elapsed();
 
-            const QImage &image = result.image;
-            if (!image.isNull())
+            // Zoom, rotation or colors changed while this page was being
+            // rasterized, or it was aborted after leaving the visible set and
+            // may have come back since. The display list is still cached, so
+            // rendering it again is cheap.
+            if (job.cookie->abort || !m_model->isRenderJobCurrent(job))
             {
                 const std::set<int> &visiblePages = getVisiblePages();
                 if (visiblePages.find(pageno) != visiblePages.end())
-                {
-                    renderPageFromImage(pageno, result.image);
-                    renderLinks(pageno, result.links);
-                    renderAnnotations(pageno, result.annotations);
-                    renderSearchHitsForPage(pageno);
-                }
+                    requestPageRender(pageno);
+                startNextRenderJob();
+                return;
+            }
 
-                if (m_pending_jump.pageno == pageno)
-                {
-                    GotoLocation(m_pending_jump);
-                }
+            if (!result.image.isNull())
+                applyPageRenderResult(job, result);
 
-                // If the page we just rendered is the page in the current
-                // search.
-                if (m_search_index != -1 && !m_search_hit_flat_refs.empty()
-                    && m_search_hit_flat_refs[m_search_index].page == pageno)
-                {
-                    updateCurrentHitHighlight();
-                }
+            startNextRenderJob();
+
+            // Everything visible is back after a resume
+            if (m_pending_renders.isEmpty() && m_renders_in_flight.isEmpty())
+                hideSuspendSnapshot();
+        });
+    }
+
+    // Tiles go after whole pages, which bring the links and annotations.
+    // Within the viewport the ones closest to its center come first.
+    const auto tileDistance = [this, &viewRect](const TileRef &tile)
+    {
+        const GraphicsPixmapItem *item = m_page_items_hash.value(tile.pageno);
+        if (!item)
+            return std::numeric_limits<double>::max();
+
+        const QPointF d = item->mapToScene(QPointF(tile.rect().center())
+                                           / m_model->DPR())
+                          - viewRect.center();
+        return std::hypot(d.x(), d.y());
+    };
+
+    while (inFlight() < m_max_concurrent_renders)
+    {
+        const TileRef *next = nullptr;
+        RenderPriority nextPriority;
+        for (const TileRef &tile : std::as_const(m_pending_tiles))
+        {
+            if (m_tiles_in_flight.contains(tile))
+                continue;
+
+            const RenderPriority priority{
+                renderPriority(tile.pageno, viewRect).first,
+                tileDistance(tile)};
+            if (!next || priority < nextPriority)
+            {
+                next         = &tile;
+                nextPriority = priority;
+            }
+        }
+
+        if (!next)
+            break;
+
+        const TileRef tile = *next;
+
+        const quint64 epoch = m_render_epoch;
+        auto job            = tileRenderJob(tile);
+        job.cookie          = std::make_shared<fz_cookie>();
+        m_tiles_in_flight.insert(tile, job.cookie);
+
+        m_model->requestPageRender(
+            job, [this, tile, epoch, job](const Model::PageRenderResult &result)
+        {
+            if (epoch != m_render_epoch)
+                return;
+
+            m_pending_tiles.remove(tile);
+            m_tiles_in_flight.remove(tile);
+
+            // Tiles of an outdated zoom level are requested again by
+            // requestPageTiles, aborted ones may be back in the viewport
+            if (job.cookie->abort)
+            {
+                const std::set<int> &visiblePages = getVisiblePages();
+                if (visiblePages.find(tile.pageno) != visiblePages.end())
+                    requestPageTiles(tile.pageno);
+            }
+            else if (!result.image.isNull() && m_model->isRenderJobCurrent(job))
+            {
+                applyTileRenderResult(tile, result);
             }
 
             startNextRenderJob();
         });
-        break;
     }
 }
 
+// Show a finished render, coming either from a worker or the render cache
+void
+DocumentView::applyPageRenderResult(
+    const Model::RenderJob &job, const Model::PageRenderResult &result) noexcept
+{
+    const int pageno                  = job.pageno;
+    const std::set<int> &visiblePages = getVisiblePages();
+    if (visiblePages.find(pageno) != visiblePages.end())
+    {
+        // Skip the pixmap upload if the page already shows this very image
+        GraphicsPixmapItem *item = m_page_items_hash.value(pageno, nullptr);
+        if (!item || item->data(1).toLongLong() != result.image.cacheKey())
+        {
+            renderPageFromImage(pageno, result.image);
+            if ((item = m_page_items_hash.value(pageno, nullptr)))
+                item->setData(2, job.zoom); // tiles are only laid over this
+        }
+
+        renderLinks(pageno, Model::snapshotItems(result.links));
+        renderAnnotations(pageno, Model::snapshotItems(result.annotations));
+        renderSearchHitsForPage(pageno);
+        requestPageTiles(pageno);
+    }
+
+    if (m_pending_jump.pageno == pageno)
+    {
+        GotoLocation(m_pending_jump);
+    }
+
+    // If the page we just rendered is the page in the current
+    // search.
+    if (m_search_index != -1 && !m_search_hit_flat_refs.empty()
+        && m_search_hit_flat_refs[m_search_index].page == pageno)
+    {
+        updateCurrentHitHighlight();
+    }
+}
+
+// Job for a whole page. Pages too large to rasterize in one piece are rendered
+// at a reduced resolution, requestPageTiles fills in the details.
+Model::RenderJob
+DocumentView::pageRenderJob(int pageno) const noexcept
+{
+    Model::RenderJob job = m_model->createRenderJob(pageno);
+    if (pageNeedsTiles())
+    {
+        const QSizeF size = currentPageSceneSize() * m_model->DPR();
+        job.raster_scale  = std::sqrt(static_cast<double>(m_tile_threshold)
+                                      / (size.width() * size.height()));
+    }
+    return job;
+}
+
+Model::RenderJob
+DocumentView::previewRenderJob(int pageno) const noexcept
+{
+    Model::RenderJob job = pageRenderJob(pageno);
+    job.raster_scale *= m_preview_scale;
+    job.preview = true;
+    return job;
+}
+
+Model::RenderJob
+DocumentView::tileRenderJob(const TileRef &tile) const noexcept
+{
+    Model::RenderJob job = m_model->createRenderJob(tile.pageno);
+    job.tile             = tile.rect();
+    return job;
+}
+
+// Whether the page shows a render (possibly a preview, or from another zoom
+// level) rather than a blank placeholder
+bool
+DocumentView::pageHasContent(int pageno) const noexcept
+{
+    const GraphicsPixmapItem *item = m_page_items_hash.value(pageno);
+    return item && item->data(0).toString() != "placeholder_page";
+}
+
+void
+DocumentView::requestPagePreview(int pageno) noexcept
+{
+    if (m_preview_scale <= 0.0 || m_pending_previews.contains(pageno))
+        return;
+
+    if (const Model::PageRenderResult *cached
+        = m_model->cachedPageRender(previewRenderJob(pageno)))
+    {
+        renderPageFromImage(pageno, cached->image);
+        return;
+    }
+
+    m_pending_previews.insert(pageno);
+}
+
+bool
+DocumentView::pageNeedsTiles() const noexcept
+{
+    if (m_tile_threshold <= 0)
+        return false;
+
+    const QSizeF size = currentPageSceneSize() * m_model->DPR();
+    return size.width() * size.height() > m_tile_threshold;
+}
+
+// Request the tiles of a large page that intersect the viewport, and drop the
+// ones that scrolled out of it. Dropped tiles stay in the render cache.
+void
+DocumentView::requestPageTiles(int pageno) noexcept
+{
+    GraphicsPixmapItem *pageItem = m_page_items_hash.value(pageno, nullptr);
+    if (!pageItem)
+        return;
+
+    // Tiles are children of the page item, so they need a page rendered at
+    // the current zoom to sit on
+    const double zoom = m_model->createRenderJob(pageno).zoom;
+    QSet<TileRef> wanted;
+    if (pageNeedsTiles() && pageItem->data(2).toDouble() == zoom)
+    {
+        const double dpr = m_model->DPR();
+        const QRectF viewRect
+            = m_gview->mapToScene(m_gview->viewport()->rect()).boundingRect();
+        const QRectF visible
+            = pageItem->mapFromScene(viewRect).boundingRect().intersected(
+                QRectF(QPointF(0, 0), currentPageSceneSize()));
+
+        if (!visible.isEmpty())
+        {
+            // Device pixel range covered by the viewport, the page's pixel
+            // size is rounded the same way by the renderer
+            const int col0 = static_cast<int>(visible.left() * dpr);
+            const int col1 = std::lround(visible.right() * dpr) - 1;
+            const int row0 = static_cast<int>(visible.top() * dpr);
+            const int row1 = std::lround(visible.bottom() * dpr) - 1;
+
+            for (int row = row0 / RENDER_TILE_SIZE;
+                 row <= row1 / RENDER_TILE_SIZE; ++row)
+                for (int col = col0 / RENDER_TILE_SIZE;
+                     col <= col1 / RENDER_TILE_SIZE; ++col)
+                    wanted.insert(TileRef{pageno, col, row});
+        }
+    }
+
+    QSet<TileRef> shown;
+    for (QGraphicsItem *child : pageItem->childItems())
+    {
+        if (child->data(0).toString() != "page_tile")
+            continue;
+
+        const TileRef tile{pageno, child->data(1).toInt(),
+                           child->data(2).toInt()};
+        if (wanted.contains(tile))
+            shown.insert(tile);
+        else
+            delete child;
+    }
+
+    for (auto it = m_pending_tiles.begin(); it != m_pending_tiles.end();)
+    {
+        if (it->pageno != pageno || wanted.contains(*it))
+        {
+            ++it;
+            continue;
+        }
+
+        if (const auto cookie = m_tiles_in_flight.value(*it))
+        {
+            cookie->abort = 1;
+            ++it;
+        }
+        else
+        {
+            it = m_pending_tiles.erase(it);
+        }
+    }
+
+    for (const TileRef &tile : wanted)
+    {
+        if (shown.contains(tile) || m_pending_tiles.contains(tile))
+            continue;
+
+        if (const Model::PageRenderResult *cached
+            = m_model->cachedPageRender(tileRenderJob(tile)))
+        {
+            const Model::PageRenderResult result = *cached;
+            applyTileRenderResult(tile, result);
+            continue;
+        }
+
+        m_pending_tiles.insert(tile);
+    }
+}
+
+void
+DocumentView::applyTileRenderResult(
+    const TileRef &tile, const Model::PageRenderResult &result) noexcept
+{
+    const double zoom = m_model->createRenderJob(tile.pageno).zoom;
+    GraphicsPixmapItem *pageItem = m_page_items_hash.value(tile.pageno);
+    if (!pageItem || pageItem->data(2).toDouble() != zoom)
+        return;
+
+    for (QGraphicsItem *child : pageItem->childItems())
+    {
+        if (child->data(0).toString() == "page_tile"
+            && child->data(1).toInt() == tile.col
+            && child->data(2).toInt() == tile.row)
+            return;
+    }
+
+    // The image carries the device pixel ratio, so the tile is laid out in
+    // the page item's logical coordinates
+    const double dpr = m_model->DPR();
+    auto *item
+        = new QGraphicsPixmapItem(QPixmap::fromImage(result.image), pageItem);
+    item->setPos(QPointF(tile.rect().topLeft()) / dpr);
+    item->setAcceptedMouseButtons(Qt::NoButton);
+    item->setData(0, QStringLiteral("page_tile"));
+    item->setData(1, tile.col);
+    item->setData(2, tile.row);
+}
+
 void
 DocumentView::renderPageFromImage(int pageno, const QImage &image) noexcept
 {
@@ -2465,6 +3201,10 @@ DocumentView::renderPageFromImage(int pageno, const QImage &image) noexcept
     clearAnnotationsForPage(pageno);
     removePageItem(pageno);
     createAndAddPageItem(pageno, QPixmap::fromImage(image));
+
+    // Remember which image the item shows, see applyPageRenderResult
+    if (GraphicsPixmapItem *item = m_page_items_hash.value(pageno, nullptr))
+        item->setData(1, image.cacheKey());
 }
 
 void
@@ -2829,6 +3569,7 @@ DocumentView::reloadPage(int pageno) noexcept
 #endif
     removePageItem(pageno);
     requestPageRender(pageno);
+    startNextRenderJob();
 }
 
 bool
@@ -3413,6 +4154,10 @@ DocumentView::onFileReloadRequested(const QString &path) noexcept
     if (path != m_model->filePath())
         return;
 
+    // Reopened from disk on resume anyway
+    if (m_suspended)
+        return;
+
     tryReloadLater(0);
 }
 
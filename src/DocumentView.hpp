@@ -21,11 +21,12 @@ extern "C"
 }
 #endif
 
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
 #include <QGraphicsItem>
 #include <QHash>
-#include <QQueue>
+#include <QLabel>
 #include <QScrollBar>
 #include <QSet>
 #include <QString>
@@ -45,6 +46,17 @@ extern "C"
 #define MIN_ZOOM_FACTOR 0.1
 #define MAX_ZOOM_FACTOR 5.0
 
+// Edge of a high zoom render tile, in device pixels
+#define RENDER_TILE_SIZE 1024
+
+// Visible pages are re-evaluated at most this often while scrolling
+#define SCROLL_RENDER_INTERVAL_MS 100
+// Scroll speed, in pages per second, at which preloading is fully biased
+// towards the direction of travel
+#define FAST_SCROLL_PAGES_PER_SEC 4.0
+// Resolution of the viewport screenshot kept for a suspended tab
+#define SUSPEND_SNAPSHOT_SCALE 0.5
+
 #define CSTR(x) x.toStdString().c_str()
 
 class DocumentView : public QWidget
@@ -205,6 +217,19 @@ public:
         return m_is_modified;
     }
 
+    inline bool isSuspended() const noexcept
+    {
+        return m_suspended;
+    }
+
+    // Releases the document and everything rendered from it, keeping only a
+    // low resolution screenshot of the viewport. Refused for modified or
+    // password protected documents.
+    bool suspend() noexcept;
+    // Reopens a suspended document, showing the screenshot until the visible
+    // pages are rendered again
+    void resume() noexcept;
+
     void FollowLink(const Model::LinkInfo &info) noexcept;
 
     void setInvertColor(bool invert) noexcept;
@@ -226,7 +251,8 @@ public:
     void GotoFirstPage() noexcept;
     void GotoLastPage() noexcept;
     void setZoom(double factor) noexcept;
-    void Search(const QString &term) noexcept;
+    void Search(const QString &term,
+                SearchQuery::Options options = {}) noexcept;
     void ZoomIn() noexcept;
     void ZoomOut() noexcept;
     void ZoomReset() noexcept;
@@ -290,6 +316,8 @@ public slots:
     void handleClickSelection(int clickType, const QPointF &scenePos) noexcept;
     void handleSearchResults(
         const QMap<int, std::vector<Model::SearchHit>> &results) noexcept;
+    void handleSearchFinished(int matchCount) noexcept;
+    void handleSearchFailed(const QString &error) noexcept;
     void handleAnnotSelectRequested(const QRectF &area) noexcept;
     void handleAnnotSelectRequested(const QPointF &area) noexcept;
     void handleAnnotSelectClearRequested() noexcept;
@@ -314,6 +342,27 @@ private:
         int indexInPage;
     };
 
+    // Column and row of a RENDER_TILE_SIZE tile at the current zoom
+    struct TileRef
+    {
+        int pageno;
+        int col;
+        int row;
+
+        bool operator==(const TileRef &) const = default;
+
+        friend size_t qHash(const TileRef &tile, size_t seed = 0) noexcept
+        {
+            return qHashMulti(seed, tile.pageno, tile.col, tile.row);
+        }
+
+        inline QRect rect() const noexcept
+        {
+            return QRect(col * RENDER_TILE_SIZE, row * RENDER_TILE_SIZE,
+                         RENDER_TILE_SIZE, RENDER_TILE_SIZE);
+        }
+    };
+
     inline int selectionPage() const noexcept
     {
         if (!m_selection_path_item)
@@ -343,6 +392,17 @@ private:
     void clearVisiblePages() noexcept;
     void clearVisibleLinks() noexcept;
     void renderPageFromImage(int pageno, const QImage &image) noexcept;
+    void applyPageRenderResult(const Model::RenderJob &job,
+                               const Model::PageRenderResult &result) noexcept;
+    Model::RenderJob pageRenderJob(int pageno) const noexcept;
+    Model::RenderJob tileRenderJob(const TileRef &tile) const noexcept;
+    Model::RenderJob previewRenderJob(int pageno) const noexcept;
+    void requestPagePreview(int pageno) noexcept;
+    bool pageHasContent(int pageno) const noexcept;
+    bool pageNeedsTiles() const noexcept;
+    void requestPageTiles(int pageno) noexcept;
+    void applyTileRenderResult(const TileRef &tile,
+                               const Model::PageRenderResult &result) noexcept;
     void renderLinks(int pageno,
                      const std::vector<Model::RenderLink> &links) noexcept;
     void renderAnnotations(
@@ -368,6 +428,13 @@ private:
     void removePageItem(int pageno) noexcept;
     void createAndAddPlaceholderPageItem(int pageno) noexcept;
     void prunePendingRenders(const std::set<int> &visiblePages) noexcept;
+    // Tier (viewport, ahead, behind) and distance from the viewport center
+    using RenderPriority = std::pair<int, double>;
+    RenderPriority renderPriority(int pageno,
+                                  const QRectF &viewRect) const noexcept;
+    void trackScrollMotion(int value) noexcept;
+    bool isPassedBeforeRendered(int pageno,
+                                const QRectF &viewRect) const noexcept;
     void renderSearchHitsForPage(int pageno) noexcept;
     void renderSearchHitsInScrollbar() noexcept;
     void clearSearchHits() noexcept;
@@ -402,10 +469,29 @@ private:
     QHash<int, std::vector<BrowseLinkItem *>> m_page_links_hash;
     QHash<int, std::vector<Annotation *>> m_page_annotations_hash;
     QSet<int> m_pending_renders;
-    QQueue<int> m_render_queue;
-    bool m_render_in_flight{false};
-    int m_render_in_flight_page{-1};
-    float m_old_y{0.0f};
+    // In-flight jobs, with the cookie that aborts them
+    QHash<int, std::shared_ptr<fz_cookie>> m_renders_in_flight;
+    // Low resolution first pass for pages that are still blank
+    double m_preview_scale{0.0};
+    QSet<int> m_pending_previews;
+    QHash<int, std::shared_ptr<fz_cookie>> m_previews_in_flight;
+    // Pages above m_tile_threshold device pixels are shown at a reduced
+    // resolution, with full resolution tiles over the visible part
+    qint64 m_tile_threshold{0};
+    QSet<TileRef> m_pending_tiles;
+    QHash<TileRef, std::shared_ptr<fz_cookie>> m_tiles_in_flight;
+    int m_max_concurrent_renders{1};
+    // Bumped whenever the scene is reset so late results can be discarded
+    quint64 m_render_epoch{0};
+    // Last scroll movement along the main axis: -1 back, 1 forward, 0 none
+    int m_scroll_direction{0};
+    int m_last_scroll_value{0};
+    // Smoothed scroll speed in scene units per second, 0 at rest
+    double m_scroll_velocity{0.0};
+    QElapsedTimer m_scroll_clock;
+    QElapsedTimer m_render_pass_clock;
+    // Smoothed time from dispatching a page render to its result
+    double m_avg_render_ms{50.0};
     JumpMarker *m_jump_marker{nullptr};
     QTimer *m_scroll_page_update_timer{nullptr};
     QTimer *m_resize_timer{nullptr};
@@ -431,6 +517,18 @@ private:
     bool m_deferred_fit{false};
     QFileSystemWatcher *m_file_watcher{nullptr};
 
+    // What is left of a suspended tab
+    struct SuspendSnapshot
+    {
+        QPixmap viewport;
+        QSize viewport_size;
+        PageLocation location{-1, 0, 0};
+    };
+    void hideSuspendSnapshot() noexcept;
+    bool m_suspended{false};
+    SuspendSnapshot m_suspend_snapshot;
+    QLabel *m_snapshot_label{nullptr};
+
 #ifdef HAS_SYNCTEX
     synctex_scanner_p m_synctex_scanner{nullptr};
 #endif
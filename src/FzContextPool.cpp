@@ -0,0 +1,91 @@
+#include "FzContextPool.hpp"
+
+#include <algorithm>
+
+namespace
+{
+thread_local fz_context *t_leased_ctx = nullptr;
+}
+
+FzContextPool::Lease::Lease(FzContextPool &pool) noexcept
+    : m_pool(pool), m_ctx(pool.acquire()), m_prev_thread_ctx(t_leased_ctx)
+{
+    if (m_ctx)
+        t_leased_ctx = m_ctx;
+}
+
+FzContextPool::Lease::~Lease() noexcept
+{
+    t_leased_ctx = m_prev_thread_ctx;
+    m_pool.release(m_ctx);
+}
+
+FzContextPool::~FzContextPool() noexcept
+{
+    clear();
+}
+
+fz_context *
+FzContextPool::acquire() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    fz_context *ctx = nullptr;
+    if (!m_idle.empty())
+    {
+        ctx = m_idle.back();
+        m_idle.pop_back();
+    }
+    else if (m_base)
+    {
+        // Cloning reads the base context, keep it serialized with the pool
+        ctx = fz_clone_context(m_base);
+        if (!ctx)
+            return nullptr;
+        ++m_stats.created;
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    ++m_stats.borrowed;
+    ++m_stats.in_use;
+    m_stats.peak_in_use = std::max(m_stats.peak_in_use, m_stats.in_use);
+    return ctx;
+}
+
+void
+FzContextPool::release(fz_context *ctx) noexcept
+{
+    if (!ctx)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_stats.in_use;
+    m_idle.push_back(ctx);
+}
+
+void
+FzContextPool::clear() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (fz_context *ctx : m_idle)
+        fz_drop_context(ctx);
+    m_idle.clear();
+}
+
+FzContextPool::Stats
+FzContextPool::stats() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.idle  = m_idle.size();
+    return stats;
+}
+
+fz_context *
+FzContextPool::threadContext() noexcept
+{
+    return t_leased_ctx;
+}
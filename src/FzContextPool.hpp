@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+extern "C"
+{
+#include <mupdf/fitz.h>
+}
+
+// Long-lived MuPDF contexts cloned from a base context. Workers borrow one
+// for the duration of a job and hand it back, so a context is only ever used
+// by one thread at a time and clones are created once per concurrent worker
+// instead of once per job.
+class FzContextPool
+{
+public:
+    struct Stats
+    {
+        size_t created{0};     // contexts cloned so far
+        size_t borrowed{0};    // leases handed out
+        size_t in_use{0};      // leases currently held
+        size_t peak_in_use{0}; // most leases held at the same time
+        size_t idle{0};        // contexts waiting for a job
+    };
+
+    // Borrows a context for the enclosing scope
+    class Lease
+    {
+    public:
+        explicit Lease(FzContextPool &pool) noexcept;
+        ~Lease() noexcept;
+
+        Lease(const Lease &)            = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        inline fz_context *ctx() const noexcept
+        {
+            return m_ctx;
+        }
+
+    private:
+        FzContextPool &m_pool;
+        fz_context *m_ctx{nullptr};
+        fz_context *m_prev_thread_ctx{nullptr};
+    };
+
+    FzContextPool() noexcept = default;
+    ~FzContextPool() noexcept;
+
+    FzContextPool(const FzContextPool &)            = delete;
+    FzContextPool &operator=(const FzContextPool &) = delete;
+
+    inline void setBaseContext(fz_context *base) noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_base = base;
+    }
+
+    fz_context *acquire() noexcept;
+    void release(fz_context *ctx) noexcept;
+
+    // Drops the idle contexts, must not be called while leases are held
+    void clear() noexcept;
+
+    Stats stats() const noexcept;
+
+    // Context leased by the calling thread, nullptr outside of a lease
+    static fz_context *threadContext() noexcept;
+
+private:
+    fz_context *m_base{nullptr};
+    std::vector<fz_context *> m_idle;
+    Stats m_stats;
+    mutable std::mutex m_mutex;
+};
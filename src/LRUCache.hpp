@@ -1,115 +1,399 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
-#include <stdexcept>
-#include <unordered_map>
+#include <limits>
+#include <utility>
+#include <vector>
 
-template <typename K, typename V> class LRUCache
+// Least recently used cache. Entries live in a slab threaded by an intrusive
+// recency list and are found through an open addressing index, so a lookup
+// touches no list nodes and inserts reuse the slots of evicted entries
+// instead of allocating. Entries can be pinned to keep them from being
+// evicted while they are in use.
+template <typename K, typename V, typename Hash = std::hash<K>> class LRUCache
 {
 public:
     using EvictCallback = std::function<void(V &)>;
 
-    LRUCache() {}
+    // One pinned entry. Unpinning it never touches an entry put later under
+    // the same key, after the pinned one was removed or the cache cleared.
+    class Pin
+    {
+    public:
+        Pin() = default;
+
+        inline explicit operator bool() const
+        {
+            return m_serial != 0;
+        }
+
+    private:
+        friend class LRUCache;
+        Pin(uint32_t node, uint64_t serial) : m_node(node), m_serial(serial)
+        {
+        }
+
+        uint32_t m_node{0};
+        uint64_t m_serial{0};
+    };
 
-    // LRUCache(size_t capacity, EvictCallback onEvict)
-    //     : m_capacity(capacity), m_onEvict(onEvict)
-    // {
-    // }
+    struct Stats
+    {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0}; // dropped to make room, not removed explicitly
+    };
+
+    LRUCache() {}
 
     inline void setCapacity(const size_t capacity)
     {
         m_capacity = capacity;
+        trim();
     }
 
+    // Upper bound on the summed weight of all entries, entries put without a
+    // weight count as 1
+    inline void setMaxWeight(const size_t maxWeight)
+    {
+        m_max_weight = maxWeight;
+        trim();
+    }
+
+    inline size_t weight() const
+    {
+        return m_weight;
+    }
+
+    // Only called when an entry leaves the cache, never on lookups
     inline void setCallback(EvictCallback onEvict)
     {
-        m_onEvict = onEvict;
+        m_onEvict = std::move(onEvict);
     }
 
     V *get(const K &key)
     {
-        auto it = m_map.find(key);
-        if (it == m_map.end())
+        const uint32_t node = find(key);
+        if (node == NIL)
+        {
+            ++m_stats.misses;
             return nullptr;
+        }
 
-        m_list.splice(m_list.begin(), m_list, it->second.second);
-        return &(it->second.first);
+        ++m_stats.hits;
+        moveToFront(node);
+        return &m_values[node];
+    }
+
+    // Looks up without touching the recency order or the statistics
+    const V *peek(const K &key) const
+    {
+        const uint32_t node = find(key);
+        return node != NIL ? &m_values[node] : nullptr;
     }
 
     inline bool has(const K &key) const
     {
-        return m_map.find(key) != m_map.end();
+        return find(key) != NIL;
     }
 
-    void put(const K &key, V value)
+    void put(const K &key, V value, size_t weight = 1)
     {
         if (m_capacity == 0)
             return;
 
-        auto it = m_map.find(key);
-        if (it != m_map.end())
+        uint32_t node = find(key);
+        if (node != NIL)
         {
-            it->second.first = std::move(value);
-            m_list.splice(m_list.begin(), m_list, it->second.second);
+            Node &n        = m_nodes[node];
+            m_weight       = m_weight - n.weight + weight;
+            m_values[node] = std::move(value);
+            n.weight       = weight;
+            moveToFront(node);
+            trim();
             return;
         }
 
-        if (m_map.size() >= m_capacity)
-            evict();
+        if ((m_size + 1) * 2 > m_index.size())
+            rehash(std::max<size_t>(16, m_index.size() * 2));
 
-        m_list.push_front(key);
-        m_map[key] = {std::move(value), m_list.begin()};
+        if (!m_free.empty())
+        {
+            node = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            node = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.emplace_back();
+            m_values.emplace_back();
+        }
+
+        m_values[node] = std::move(value);
+        Node &n        = m_nodes[node];
+        n.key          = key;
+        n.hash         = hashOf(key);
+        n.weight       = weight;
+        n.pins         = 0;
+        n.serial       = ++m_serial;
+
+        insertIndex(node);
+        pushFront(node);
+        ++m_size;
+        m_weight += weight;
+        trim();
     }
 
     inline size_t size() const
     {
-        return m_list.size();
+        return m_size;
     }
 
     void remove(const K &key)
     {
-        auto it = m_map.find(key);
-        if (it == m_map.end())
+        const uint32_t node = find(key);
+        if (node != NIL)
+            erase(node, false);
+    }
+
+    // Removes every entry whose key satisfies pred
+    template <typename Pred> void removeIf(Pred pred)
+    {
+        for (uint32_t node = m_head; node != NIL;)
+        {
+            const uint32_t next = m_nodes[node].next;
+            if (pred(m_nodes[node].key))
+                erase(node, false);
+            node = next;
+        }
+    }
+
+    // A pinned entry is never evicted, only removed explicitly. Pins nest.
+    // Empty if key is not cached.
+    Pin pin(const K &key)
+    {
+        const uint32_t node = find(key);
+        if (node == NIL)
+            return Pin();
+
+        ++m_nodes[node].pins;
+        return Pin(node, m_nodes[node].serial);
+    }
+
+    // Does nothing if the pinned entry is gone
+    void unpin(const Pin &pin)
+    {
+        if (!pin || pin.m_node >= m_nodes.size())
             return;
 
-        if (m_onEvict)
-            m_onEvict(it->second.first);
+        Node &n = m_nodes[pin.m_node];
+        if (n.serial != pin.m_serial || n.pins == 0)
+            return;
 
-        m_list.erase(it->second.second);
-        m_map.erase(it);
+        if (--n.pins == 0)
+            trim();
     }
 
     void clear()
     {
         if (m_onEvict)
         {
-            for (auto &entry : m_map)
-                m_onEvict(entry.second.first);
+            for (uint32_t node = m_head; node != NIL; node = m_nodes[node].next)
+                m_onEvict(m_values[node]);
         }
 
-        m_map.clear();
-        m_list.clear();
+        m_nodes.clear();
+        m_values.clear();
+        m_free.clear();
+        m_index.assign(m_index.size(), NIL);
+        m_head   = NIL;
+        m_tail   = NIL;
+        m_size   = 0;
+        m_weight = 0;
+    }
+
+    inline const Stats &stats() const
+    {
+        return m_stats;
+    }
+
+    inline void resetStats()
+    {
+        m_stats = {};
     }
 
 private:
-    void evict() noexcept
+    static constexpr uint32_t NIL = std::numeric_limits<uint32_t>::max();
+
+    struct Node
     {
-        if (m_list.empty())
-            return;
+        K key{};
+        size_t hash{0};
+        size_t weight{0};
+        uint32_t prev{NIL};
+        uint32_t next{NIL}; // towards the least recently used end
+        uint32_t pins{0};
+        uint64_t serial{0}; // 0 once removed, see Pin
+    };
 
-        K lastKey = m_list.back();
-        auto it   = m_map.find(lastKey);
+    // Spreads the bits of weak hashes (std::hash<int> is the identity) over
+    // the low bits used by the index
+    static inline size_t hashOf(const K &key)
+    {
+        uint64_t h = static_cast<uint64_t>(Hash{}(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    uint32_t find(const K &key) const
+    {
+        if (m_size == 0)
+            return NIL;
 
+        const size_t mask = m_index.size() - 1;
+        const size_t hash = hashOf(key);
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+        {
+            const uint32_t node = m_index[slot];
+            if (node == NIL)
+                return NIL;
+            if (m_nodes[node].hash == hash && m_nodes[node].key == key)
+                return node;
+        }
+    }
+
+    void insertIndex(uint32_t node)
+    {
+        const size_t mask = m_index.size() - 1;
+        size_t slot       = m_nodes[node].hash & mask;
+        while (m_index[slot] != NIL)
+            slot = (slot + 1) & mask;
+        m_index[slot] = node;
+    }
+
+    // Backward shift deletion, keeps probe chains intact without tombstones
+    void eraseIndex(uint32_t node)
+    {
+        const size_t mask = m_index.size() - 1;
+        size_t hole       = m_nodes[node].hash & mask;
+        while (m_index[hole] != node)
+            hole = (hole + 1) & mask;
+
+        for (size_t slot = (hole + 1) & mask; m_index[slot] != NIL;
+             slot        = (slot + 1) & mask)
+        {
+            const size_t home = m_nodes[m_index[slot]].hash & mask;
+            // Stays if its home lies cyclically in (hole, slot]
+            const bool stays = hole <= slot ? (hole < home && home <= slot)
+                                            : (hole < home || home <= slot);
+            if (stays)
+                continue;
+
+            m_index[hole] = m_index[slot];
+            hole          = slot;
+        }
+        m_index[hole] = NIL;
+    }
+
+    void rehash(size_t slots)
+    {
+        m_index.assign(slots, NIL);
+        for (uint32_t node = m_head; node != NIL; node = m_nodes[node].next)
+            insertIndex(node);
+    }
+
+    void unlink(uint32_t node)
+    {
+        Node &n = m_nodes[node];
+        if (n.prev != NIL)
+            m_nodes[n.prev].next = n.next;
+        else
+            m_head = n.next;
+        if (n.next != NIL)
+            m_nodes[n.next].prev = n.prev;
+        else
+            m_tail = n.prev;
+        n.prev = n.next = NIL;
+    }
+
+    void pushFront(uint32_t node)
+    {
+        Node &n = m_nodes[node];
+        n.prev  = NIL;
+        n.next  = m_head;
+        if (m_head != NIL)
+            m_nodes[m_head].prev = node;
+        m_head = node;
+        if (m_tail == NIL)
+            m_tail = node;
+    }
+
+    inline void moveToFront(uint32_t node)
+    {
+        if (node == m_head)
+            return;
+        unlink(node);
+        pushFront(node);
+    }
+
+    void erase(uint32_t node, bool evicted)
+    {
+        Node &n = m_nodes[node];
         if (m_onEvict)
-            m_onEvict(it->second.first);
+            m_onEvict(m_values[node]);
+
+        eraseIndex(node);
+        unlink(node);
+        m_weight -= n.weight;
+        --m_size;
+        if (evicted)
+            ++m_stats.evictions;
 
-        m_map.erase(it);
-        m_list.pop_back();
+        // Release whatever the value holds, the slot is reused later
+        m_values[node] = V{};
+        n.serial       = 0;
+        m_free.push_back(node);
+    }
+
+    // Evicts least recently used, unpinned entries until both the entry
+    // count and the weight fit. The most recent entry is always kept, even if
+    // it alone is heavier than the budget.
+    void trim()
+    {
+        uint32_t victim = m_tail;
+        while (m_size > 1
+               && (m_size > m_capacity || m_weight > m_max_weight))
+        {
+            while (victim != NIL
+                   && (m_nodes[victim].pins > 0 || victim == m_head))
+                victim = m_nodes[victim].prev;
+            if (victim == NIL)
+                return;
+
+            const uint32_t prev = m_nodes[victim].prev;
+            erase(victim, true);
+            victim = prev;
+        }
     }
 
     size_t m_capacity{0};
-    std::list<K> m_list;
-    std::unordered_map<K, std::pair<V, typename std::list<K>::iterator>> m_map;
+    size_t m_max_weight{std::numeric_limits<size_t>::max()};
+    size_t m_weight{0};
+    size_t m_size{0};
+    uint32_t m_head{NIL}; // most recently used
+    uint32_t m_tail{NIL}; // least recently used
+    // Walked by every lookup and list update. Values are kept apart, in
+    // stable storage because get() hands out pointers.
+    std::vector<Node> m_nodes;
+    std::deque<V> m_values; // by node, like m_nodes
+    std::vector<uint32_t> m_free;
+    std::vector<uint32_t> m_index; // power of two slots, at most half full
+    Stats m_stats;
+    uint64_t m_serial{0}; // last one given to an entry, never reset
     EvictCallback m_onEvict;
 };
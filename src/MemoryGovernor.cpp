@@ -0,0 +1,122 @@
+#include "MemoryGovernor.hpp"
+
+#include "Model.hpp"
+
+#include <algorithm>
+
+MemoryGovernor &
+MemoryGovernor::instance() noexcept
+{
+    static MemoryGovernor governor;
+    return governor;
+}
+
+void
+MemoryGovernor::setLimit(size_t bytes) noexcept
+{
+    if (bytes == m_limit)
+        return;
+
+    m_limit = bytes;
+    rebalance();
+    enforceLimit();
+}
+
+void
+MemoryGovernor::registerModel(Model *model) noexcept
+{
+    // New documents start in the background until they are shown
+    m_clients.push_back({model, 0});
+    rebalance();
+}
+
+void
+MemoryGovernor::unregisterModel(Model *model) noexcept
+{
+    std::erase_if(m_clients,
+                  [model](const Client &c) { return c.model == model; });
+    rebalance();
+}
+
+void
+MemoryGovernor::touch(Model *model) noexcept
+{
+    auto it = std::find_if(m_clients.begin(), m_clients.end(),
+                           [model](const Client &c)
+    { return c.model == model; });
+    if (it == m_clients.end())
+        return;
+
+    // Already the most recent one, nothing changes
+    if (it == m_clients.begin() && it->last_shown != 0)
+        return;
+
+    it->last_shown = ++m_clock;
+    std::rotate(m_clients.begin(), it, it + 1);
+    rebalance();
+}
+
+void
+MemoryGovernor::reportUsage(Model *) noexcept
+{
+    enforceLimit();
+}
+
+size_t
+MemoryGovernor::usage() const noexcept
+{
+    size_t total = 0;
+    for (const Client &c : m_clients)
+        total += c.model->memoryUsage();
+    return total;
+}
+
+// The shown document weighs 1, each older one half of the previous one, so
+// a few recently visited tabs keep useful caches and old ones get little.
+void
+MemoryGovernor::rebalance() noexcept
+{
+    if (m_limit == 0)
+    {
+        for (const Client &c : m_clients)
+            c.model->setMemoryShare(0);
+        return;
+    }
+
+    double total_weight = 0.0;
+    double weight       = 1.0;
+    for (size_t i = 0; i < m_clients.size(); ++i, weight *= 0.5)
+        total_weight += weight;
+
+    weight = 1.0;
+    for (const Client &c : m_clients)
+    {
+        const size_t share = static_cast<size_t>(
+            static_cast<double>(m_limit) * weight / total_weight);
+        // 0 means unlimited, keep at least a byte so old tabs stay bounded
+        c.model->setMemoryShare(std::max<size_t>(share, 1));
+        weight *= 0.5;
+    }
+}
+
+void
+MemoryGovernor::enforceLimit() noexcept
+{
+    if (m_limit == 0 || m_clients.size() < 2)
+        return;
+
+    size_t total = usage();
+
+    // Least recently shown first, the front document is never shed
+    for (auto it = m_clients.rbegin();
+         total > m_limit && it != m_clients.rend() - 1; ++it)
+    {
+        const size_t before = it->model->memoryUsage();
+        if (before == 0)
+            continue;
+
+        it->model->shedMemory();
+        const size_t after = it->model->memoryUsage();
+        total -= std::min(total, before - std::min(before, after));
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Model;
+
+// Process-wide memory limit shared by every open document. Each Model gets a
+// share of the limit for its caches, weighted by how recently its view was
+// shown, and background documents are asked to drop their caches when the
+// total goes over the limit. GUI thread only.
+class MemoryGovernor
+{
+public:
+    static MemoryGovernor &instance() noexcept;
+
+    // 0 disables the governor, every Model then uses its configured budgets
+    void setLimit(size_t bytes) noexcept;
+
+    inline size_t limit() const noexcept
+    {
+        return m_limit;
+    }
+
+    void registerModel(Model *model) noexcept;
+    void unregisterModel(Model *model) noexcept;
+
+    // model's view was shown, it becomes the most important one
+    void touch(Model *model) noexcept;
+
+    // Called when a Model cached something; sheds background documents if
+    // the total went over the limit
+    void reportUsage(Model *model) noexcept;
+
+    size_t usage() const noexcept;
+
+private:
+    MemoryGovernor() noexcept = default;
+
+    struct Client
+    {
+        Model *model;
+        uint64_t last_shown;
+    };
+
+    void rebalance() noexcept;
+    void enforceLimit() noexcept;
+
+    std::vector<Client> m_clients; // most recently shown first
+    uint64_t m_clock{0};
+    size_t m_limit{0};
+};
@@ -1,12 +1,17 @@
 #include "Model.hpp"
 
 #include "BrowseLinkItem.hpp"
+#include "MemoryGovernor.hpp"
+#include "PixelTransform.hpp"
 #include "commands/TextHighlightAnnotationCommand.hpp"
 #include "utils.hpp"
 
+#include <QElapsedTimer>
 #include <QtConcurrent/QtConcurrent>
 #include <algorithm>
 #include <array>
+#include <cstdlib>
+#include <optional>
 #include <pthread.h>
 #include <qbytearrayview.h>
 #include <qregularexpression.h>
@@ -14,24 +19,7 @@
 #include <qtextformat.h>
 #include <ranges>
 #include <unordered_set>
-
-/**
- * @brief Clean up image data when the last copy of the QImage is destoryed.
-
- This is called by Qt when the last copy of the QImage is destroyed
- */
-static void
-imageCleanupHandler(void *info) noexcept
-{
-    Model::RenderPayload *payload = static_cast<Model::RenderPayload *>(info);
-    if (payload)
-    {
-        // Drop the pixmap first, then the context
-        fz_drop_pixmap(payload->ctx, payload->pix);
-        fz_drop_context(payload->ctx);
-        delete payload;
-    }
-}
+#include <utility>
 
 static std::array<std::mutex, FZ_LOCK_MAX> mupdf_mutexes;
 
@@ -49,21 +37,260 @@ mupdf_unlock_mutex(void *user, int lock)
     m[lock].unlock();
 }
 
+// Counts the bytes each Model's MuPDF contexts hold (the document, its
+// display lists and the store of decoded images and fonts) in the atomic
+// passed as user. Contexts cloned for workers share the counter.
+struct alignas(std::max_align_t) FzAllocHeader
+{
+    size_t size;
+};
+
+static void *
+mupdf_malloc(void *user, size_t size)
+{
+    auto *header = static_cast<FzAllocHeader *>(
+        std::malloc(sizeof(FzAllocHeader) + size));
+    if (!header)
+        return nullptr;
+
+    header->size = size;
+    static_cast<std::atomic<size_t> *>(user)->fetch_add(
+        size, std::memory_order_relaxed);
+    return header + 1;
+}
+
+static void *
+mupdf_realloc(void *user, void *old, size_t size)
+{
+    if (!old)
+        return mupdf_malloc(user, size);
+
+    auto *header          = static_cast<FzAllocHeader *>(old) - 1;
+    const size_t old_size = header->size;
+    header                = static_cast<FzAllocHeader *>(
+        std::realloc(header, sizeof(FzAllocHeader) + size));
+    if (!header)
+        return nullptr;
+
+    header->size = size;
+    auto *bytes  = static_cast<std::atomic<size_t> *>(user);
+    bytes->fetch_add(size, std::memory_order_relaxed);
+    bytes->fetch_sub(old_size, std::memory_order_relaxed);
+    return header + 1;
+}
+
+static void
+mupdf_free(void *user, void *ptr)
+{
+    if (!ptr)
+        return;
+
+    auto *header = static_cast<FzAllocHeader *>(ptr) - 1;
+    static_cast<std::atomic<size_t> *>(user)->fetch_sub(
+        header->size, std::memory_order_relaxed);
+    std::free(header);
+}
+
+// Replays a display list to estimate the memory it holds: the paths and
+// text it stores, the images and shadings it keeps alive, and a node per
+// command for its rectangle, matrix and color. Images shared with other
+// pages are counted by each of them, so the sum errs on the high side.
+struct DisplayListSizeDevice
+{
+    fz_device super;
+    size_t bytes;
+};
+
+static constexpr size_t DISPLAY_NODE_BYTES = 64;
+
+static inline void
+addNode(fz_device *dev, size_t bytes) noexcept
+{
+    reinterpret_cast<DisplayListSizeDevice *>(dev)->bytes
+        += DISPLAY_NODE_BYTES + bytes;
+}
+
+static size_t
+textBytes(const fz_text *text) noexcept
+{
+    size_t bytes = 0;
+    for (const fz_text_span *span = text->head; span; span = span->next)
+        bytes += sizeof(fz_text_span) + span->len * sizeof(fz_text_item);
+    return bytes;
+}
+
+static size_t
+imageBytes(fz_context *ctx, fz_image *image) noexcept
+{
+    // Undecoded images keep their compressed stream, others their pixels
+    if (fz_compressed_buffer *cbuf = fz_compressed_image_buffer(ctx, image);
+        cbuf && cbuf->buffer)
+        return cbuf->buffer->len;
+    return static_cast<size_t>(image->w) * image->h * image->n;
+}
+
+static void
+sizeFillPath(fz_context *, fz_device *dev, const fz_path *path, int,
+             fz_matrix, fz_colorspace *, const float *, float,
+             fz_color_params)
+{
+    addNode(dev, fz_packed_path_size(path));
+}
+
+static void
+sizeStrokePath(fz_context *, fz_device *dev, const fz_path *path,
+               const fz_stroke_state *, fz_matrix, fz_colorspace *,
+               const float *, float, fz_color_params)
+{
+    addNode(dev, fz_packed_path_size(path) + sizeof(fz_stroke_state));
+}
+
+static void
+sizeClipPath(fz_context *, fz_device *dev, const fz_path *path, int,
+             fz_matrix, fz_rect)
+{
+    addNode(dev, fz_packed_path_size(path));
+}
+
+static void
+sizeClipStrokePath(fz_context *, fz_device *dev, const fz_path *path,
+                   const fz_stroke_state *, fz_matrix, fz_rect)
+{
+    addNode(dev, fz_packed_path_size(path) + sizeof(fz_stroke_state));
+}
+
+static void
+sizeFillText(fz_context *, fz_device *dev, const fz_text *text, fz_matrix,
+             fz_colorspace *, const float *, float, fz_color_params)
+{
+    addNode(dev, textBytes(text));
+}
+
+static void
+sizeStrokeText(fz_context *, fz_device *dev, const fz_text *text,
+               const fz_stroke_state *, fz_matrix, fz_colorspace *,
+               const float *, float, fz_color_params)
+{
+    addNode(dev, textBytes(text) + sizeof(fz_stroke_state));
+}
+
+static void
+sizeClipText(fz_context *, fz_device *dev, const fz_text *text, fz_matrix,
+             fz_rect)
+{
+    addNode(dev, textBytes(text));
+}
+
+static void
+sizeClipStrokeText(fz_context *, fz_device *dev, const fz_text *text,
+                   const fz_stroke_state *, fz_matrix, fz_rect)
+{
+    addNode(dev, textBytes(text) + sizeof(fz_stroke_state));
+}
+
+static void
+sizeIgnoreText(fz_context *, fz_device *dev, const fz_text *text, fz_matrix)
+{
+    addNode(dev, textBytes(text));
+}
+
+static void
+sizeFillShade(fz_context *, fz_device *dev, fz_shade *shade, fz_matrix,
+              float, fz_color_params)
+{
+    addNode(dev, sizeof(fz_shade)
+                     + (shade->buffer && shade->buffer->buffer
+                            ? shade->buffer->buffer->len
+                            : 0));
+}
+
+static void
+sizeFillImage(fz_context *ctx, fz_device *dev, fz_image *image, fz_matrix,
+              float, fz_color_params)
+{
+    addNode(dev, imageBytes(ctx, image));
+}
+
+static void
+sizeFillImageMask(fz_context *ctx, fz_device *dev, fz_image *image,
+                  fz_matrix, fz_colorspace *, const float *, float,
+                  fz_color_params)
+{
+    addNode(dev, imageBytes(ctx, image));
+}
+
+static void
+sizeClipImageMask(fz_context *ctx, fz_device *dev, fz_image *image,
+                  fz_matrix, fz_rect)
+{
+    addNode(dev, imageBytes(ctx, image));
+}
+
+static size_t
+displayListBytes(fz_context *ctx, fz_display_list *list) noexcept
+{
+    size_t bytes = 0;
+    fz_device *dev{nullptr};
+
+    fz_var(dev);
+    fz_try(ctx)
+    {
+        auto *size_dev = fz_new_derived_device(ctx, DisplayListSizeDevice);
+        size_dev->super.fill_path        = sizeFillPath;
+        size_dev->super.stroke_path      = sizeStrokePath;
+        size_dev->super.clip_path        = sizeClipPath;
+        size_dev->super.clip_stroke_path = sizeClipStrokePath;
+        size_dev->super.fill_text        = sizeFillText;
+        size_dev->super.stroke_text      = sizeStrokeText;
+        size_dev->super.clip_text        = sizeClipText;
+        size_dev->super.clip_stroke_text = sizeClipStrokeText;
+        size_dev->super.ignore_text      = sizeIgnoreText;
+        size_dev->super.fill_shade       = sizeFillShade;
+        size_dev->super.fill_image       = sizeFillImage;
+        size_dev->super.fill_image_mask  = sizeFillImageMask;
+        size_dev->super.clip_image_mask  = sizeClipImageMask;
+        size_dev->bytes                  = 0;
+        dev                              = &size_dev->super;
+
+        fz_run_display_list(ctx, list, dev, fz_identity, fz_infinite_rect,
+                            nullptr);
+        fz_close_device(ctx, dev);
+        bytes = size_dev->bytes;
+    }
+    fz_always(ctx)
+    {
+        fz_drop_device(ctx, dev);
+    }
+    fz_catch(ctx)
+    {
+        qWarning() << "Failed to measure display list:"
+                   << fz_caught_message(ctx);
+    }
+
+    return bytes;
+}
+
 Model::Model(QObject *parent) noexcept : QObject(parent)
 {
     // initialize each mutex
     m_fz_locks.user   = mupdf_mutexes.data();
     m_fz_locks.lock   = mupdf_lock_mutex;
     m_fz_locks.unlock = mupdf_unlock_mutex;
-    m_ctx             = fz_new_context(nullptr, &m_fz_locks, FZ_STORE_DEFAULT);
+    m_fz_alloc        = {&m_fz_bytes, mupdf_malloc, mupdf_realloc, mupdf_free};
+    m_ctx = fz_new_context(&m_fz_alloc, &m_fz_locks, FZ_STORE_DEFAULT);
     fz_register_document_handlers(m_ctx);
     m_colorspace = fz_device_rgb(m_ctx);
+    m_ctx_pool.setBaseContext(m_ctx);
     m_undo_stack = new QUndoStack();
     setUrlLinkRegex(QString::fromUtf8(R"((https?://|www\.)[^\s<>()\"']+)"));
 
     // Eviction for LRU Cache
     m_page_lru_cache.setCallback([this](PageCacheEntry &entry)
     { LRUEvictFunction(entry); });
+
+    m_render_pool.setMaxThreadCount(1);
+
+    MemoryGovernor::instance().registerModel(this);
 }
 
 void
@@ -72,7 +299,9 @@ Model::LRUEvictFunction(PageCacheEntry &entry) noexcept
     std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
     if (entry.display_list)
     {
-        fz_drop_display_list(m_ctx, entry.display_list);
+        // Eviction can happen on a render worker, which must not share m_ctx
+        fz_context *ctx = FzContextPool::threadContext();
+        fz_drop_display_list(ctx ? ctx : m_ctx, entry.display_list);
         entry.display_list = nullptr;
     }
 }
@@ -80,6 +309,9 @@ Model::LRUEvictFunction(PageCacheEntry &entry) noexcept
 void
 Model::cleanup() noexcept
 {
+    // Render workers borrow the document and the display lists, so let them
+    // finish before tearing anything down
+    waitForRenders();
 
     fz_drop_outline(m_ctx, m_outline);
     m_outline = nullptr;
@@ -92,14 +324,34 @@ Model::cleanup() noexcept
     {
         std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
         m_page_lru_cache.clear();
+        m_page_bounds.clear();
     }
 
+    m_render_cache.clear();
+    ++m_render_cache_generation;
     m_text_cache.clear();
+    closeTextIndex();
 }
 
 Model::~Model() noexcept
 {
+    MemoryGovernor::instance().unregisterModel(this);
+    cancelSearch();
+    cancelDocumentSearch();
+    waitForSearches();
     cleanup();
+#ifndef NDEBUG
+    const FzContextPool::Stats stats = m_ctx_pool.stats();
+    qDebug() << "Render contexts: created" << stats.created << "borrowed"
+             << stats.borrowed << "peak in use" << stats.peak_in_use;
+    const auto &pages = m_page_lru_cache.stats();
+    qDebug() << "Page cache: hits" << pages.hits << "misses" << pages.misses
+             << "evictions" << pages.evictions;
+    const auto &renders = m_render_cache.stats();
+    qDebug() << "Render cache: hits" << renders.hits << "misses"
+             << renders.misses << "evictions" << renders.evictions;
+#endif
+    m_ctx_pool.clear();
     fz_drop_context(m_ctx);
 }
 
@@ -174,6 +426,8 @@ Model::openAsync(const QString &filePath, const QString &password) noexcept
         }
         fz_catch(m_ctx)
         {
+            m_ctx_pool.clear();
+            m_ctx_pool.setBaseContext(nullptr);
             fz_drop_context(m_ctx);
             m_ctx     = nullptr;
             m_success = false;
@@ -184,6 +438,7 @@ Model::openAsync(const QString &filePath, const QString &password) noexcept
         QMetaObject::invokeMethod(this, [this, filePath]()
         {
             m_filepath = filePath;
+            openTextIndex();
             emit openFileFinished();
         }, Qt::QueuedConnection);
     });
@@ -204,55 +459,84 @@ Model::clearPageCache() noexcept
     //     fz_drop_display_list(m_ctx, entry.display_list);
 
     m_page_lru_cache.clear();
+    m_render_cache.clear();
 }
 
+// Called from render workers with their own context. The page is
+// interpreted outside the cache lock, so the GUI thread is never blocked on
+// MuPDF page interpretation.
 void
-Model::ensurePageCached(int pageno) noexcept
+Model::ensurePageCached(fz_context *ctx, int pageno, fz_cookie *cookie) noexcept
 {
-    std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
-    // auto it = m_page_cache.find(pageno);
-    // if (it != m_page_cache.end())
-    //     return;
-    if (m_page_lru_cache.has(pageno))
-        return;
+    {
+        std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+        if (m_page_lru_cache.get(pageno))
+            return;
+    }
 
     // Not cached, build it
-    buildPageCache(pageno);
+    buildPageCache(ctx, pageno, cookie);
 }
 
 void
-Model::buildPageCache(int pageno) noexcept
+Model::buildPageCache(fz_context *ctx, int pageno, fz_cookie *cookie) noexcept
 {
-    std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
-    // auto it = m_page_cache.find(pageno);
-    // if (it != m_page_cache.end())
-    //     return;
-
     PageCacheEntry entry;
+    std::vector<CachedLink> links;
+    std::vector<CachedAnnotation> annotations;
 
-    // fz_context *ctx = m_ctx;
     fz_page *page{nullptr};
     fz_display_list *dlist{nullptr};
     fz_device *list_dev{nullptr};
     fz_link *head{nullptr};
     fz_rect bounds{};
     bool success{false};
+    uint64_t generation{0};
 
-    fz_try(m_ctx)
+    // Skips waiting for the document when the page is already cached
     {
-        page = fz_load_page(m_ctx, m_doc, pageno);
+        std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+        if (m_page_lru_cache.has(pageno))
+            return;
+    }
+
+    // Only one thread may use the document at a time. Recording the display
+    // list reads the document, so it cannot run outside the lock.
+    m_doc_mutex.lock();
+
+    {
+        std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+
+        // Another worker (e.g. the preview of this page) built it while we
+        // were waiting for the document
+        if (m_page_lru_cache.has(pageno))
+        {
+            m_doc_mutex.unlock();
+            return;
+        }
+
+        generation = m_page_cache_generation;
+    }
+
+    fz_try(ctx)
+    {
+        page = fz_load_page(ctx, m_doc, pageno);
         if (!page)
-            fz_throw(m_ctx, FZ_ERROR_GENERIC, "Failed to load page");
+            fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to load page");
+
+        bounds = fz_bound_page(ctx, page);
 
-        bounds = fz_bound_page(m_ctx, page);
+        dlist    = fz_new_display_list(ctx, bounds);
+        list_dev = fz_new_list_device(ctx, dlist);
 
-        dlist    = fz_new_display_list(m_ctx, bounds);
-        list_dev = fz_new_list_device(m_ctx, dlist);
+        fz_run_page(ctx, page, list_dev, fz_identity, cookie);
 
-        fz_run_page(m_ctx, page, list_dev, fz_identity, nullptr);
+        // An aborted run leaves an incomplete list, which must not be cached
+        if (cookie && cookie->abort)
+            fz_throw(ctx, FZ_ERROR_ABORT, "Aborted building page %d", pageno);
 
         // Extract links and cache them
-        head = fz_load_links(m_ctx, page);
+        head = fz_load_links(ctx, page);
         for (fz_link *link = head; link; link = link->next)
         {
             if (!link->uri)
@@ -267,7 +551,7 @@ Model::buildPageCache(int pageno) noexcept
             cl.source_loc.x = link->rect.x0;
             cl.source_loc.y = link->rect.y0;
 
-            if (fz_is_external_link(m_ctx, link->uri))
+            if (fz_is_external_link(ctx, link->uri))
             {
                 cl.type = BrowseLinkItem::LinkType::External;
             }
@@ -275,14 +559,14 @@ Model::buildPageCache(int pageno) noexcept
             {
                 float xp, yp;
                 fz_location loc
-                    = fz_resolve_link(m_ctx, m_doc, link->uri, &xp, &yp);
+                    = fz_resolve_link(ctx, m_doc, link->uri, &xp, &yp);
                 cl.type        = BrowseLinkItem::LinkType::Page;
                 cl.target_page = loc.page;
             }
             else
             {
                 fz_link_dest dest
-                    = fz_resolve_link_dest(m_ctx, m_doc, link->uri);
+                    = fz_resolve_link_dest(ctx, m_doc, link->uri);
                 cl.type         = BrowseLinkItem::LinkType::Location;
                 cl.target_page  = dest.loc.page;
                 cl.target_loc.x = dest.x;
@@ -290,24 +574,24 @@ Model::buildPageCache(int pageno) noexcept
                 cl.zoom         = dest.zoom;
             }
 
-            entry.links.push_back(std::move(cl));
+            links.push_back(std::move(cl));
         }
 
-        pdf_page *pdfPage = pdf_page_from_fz_page(m_ctx, page);
+        pdf_page *pdfPage = pdf_page_from_fz_page(ctx, page);
         if (pdfPage)
         {
             float color[3];
             int n = 3;
 
-            for (pdf_annot *annot = pdf_first_annot(m_ctx, pdfPage); annot;
-                 annot            = pdf_next_annot(m_ctx, annot))
+            for (pdf_annot *annot = pdf_first_annot(ctx, pdfPage); annot;
+                 annot            = pdf_next_annot(ctx, annot))
             {
                 CachedAnnotation ca;
-                ca.rect    = pdf_bound_annot(m_ctx, annot);
-                ca.type    = pdf_annot_type(m_ctx, annot);
-                ca.index   = pdf_to_num(m_ctx, pdf_annot_obj(m_ctx, annot));
-                ca.opacity = pdf_annot_opacity(m_ctx, annot);
-                ca.text    = pdf_annot_contents(m_ctx, annot);
+                ca.rect    = pdf_bound_annot(ctx, annot);
+                ca.type    = pdf_annot_type(ctx, annot);
+                ca.index   = pdf_to_num(ctx, pdf_annot_obj(ctx, annot));
+                ca.opacity = pdf_annot_opacity(ctx, annot);
+                ca.text    = pdf_annot_contents(ctx, annot);
 
                 if (fz_is_infinite_rect(ca.rect) || fz_is_empty_rect(ca.rect))
                     continue;
@@ -317,7 +601,7 @@ Model::buildPageCache(int pageno) noexcept
                     case PDF_ANNOT_POPUP:
                     case PDF_ANNOT_TEXT:
                     {
-                        pdf_annot_color(m_ctx, annot, &n, color);
+                        pdf_annot_color(ctx, annot, &n, color);
                         ca.color = QColor::fromRgbF(color[0], color[1],
                                                     color[2], ca.opacity);
                     }
@@ -325,7 +609,7 @@ Model::buildPageCache(int pageno) noexcept
 
                     case PDF_ANNOT_SQUARE:
                     {
-                        pdf_annot_interior_color(m_ctx, annot, &n, color);
+                        pdf_annot_interior_color(ctx, annot, &n, color);
                         ca.color = QColor::fromRgbF(color[0], color[1],
                                                     color[2], ca.opacity);
                     }
@@ -333,7 +617,7 @@ Model::buildPageCache(int pageno) noexcept
 
                     case PDF_ANNOT_HIGHLIGHT:
                     {
-                        pdf_annot_color(m_ctx, annot, &n, color);
+                        pdf_annot_color(ctx, annot, &n, color);
                         ca.color = QColor::fromRgbF(color[0], color[1],
                                                     color[2], ca.opacity);
                     }
@@ -344,42 +628,194 @@ Model::buildPageCache(int pageno) noexcept
                         continue;
                 }
 
-                entry.annotations.push_back(std::move(ca));
+                annotations.push_back(std::move(ca));
             }
         }
 
+        if (!links.empty())
+            entry.links = std::make_shared<const std::vector<CachedLink>>(
+                std::move(links));
+        if (!annotations.empty())
+            entry.annotations
+                = std::make_shared<const std::vector<CachedAnnotation>>(
+                    std::move(annotations));
         entry.display_list = dlist;
         entry.bounds       = bounds;
         success            = true;
     }
-    fz_always(m_ctx)
+    fz_always(ctx)
     {
         if (head)
-            fz_drop_link(m_ctx, head);
+            fz_drop_link(ctx, head);
         if (list_dev)
         {
-            fz_close_device(m_ctx, list_dev);
-            fz_drop_device(m_ctx, list_dev);
+            fz_close_device(ctx, list_dev);
+            fz_drop_device(ctx, list_dev);
         }
         if (page)
-            fz_drop_page(m_ctx, page);
+            fz_drop_page(ctx, page);
         if (!success && dlist)
-            fz_drop_display_list(m_ctx, dlist);
+            fz_drop_display_list(ctx, dlist);
+        m_doc_mutex.unlock();
     }
-    fz_catch(m_ctx)
+    fz_catch(ctx)
     {
-        qWarning() << "Failed to build page cache for page" << pageno << ":"
-                   << fz_caught_message(m_ctx);
+        if (fz_caught(ctx) != FZ_ERROR_ABORT)
+            qWarning() << "Failed to build page cache for page" << pageno
+                       << ":" << fz_caught_message(ctx);
         return;
     }
 
     if (!success)
         return;
 
+    // Replaying the list does not need the document
+    const size_t bytes = pageCacheEntryBytes(ctx, entry);
+
+    // Publish the entry. Another worker may have built the same page in the
+    // meantime, in which case the first one wins. If the cache was
+    // invalidated while we were building (annotation edit), the entry is
+    // stale and must not be published.
+    {
+        std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+        // Annotation edits do not move the page, the bounds are never stale
+        m_page_bounds[pageno] = entry.bounds;
+        if (generation == m_page_cache_generation
+            && !m_page_lru_cache.has(pageno))
+        {
+            m_page_lru_cache.put(pageno, std::move(entry), bytes);
+            reportMemoryUsage();
+            return;
+        }
+    }
+
+    fz_drop_display_list(ctx, entry.display_list);
+}
+
+void
+Model::suspend() noexcept
+{
+    // A document search is not cancelled, its results are still delivered
+    // to whoever asked
+    cancelSearch();
+    waitForSearches();
+    waitForRenders();
+
+    std::lock_guard<std::mutex> lock(m_doc_mutex);
+    cleanup();
+    m_ctx_pool.clear();
+    if (m_ctx)
+        fz_shrink_store(m_ctx, 0);
+}
+
+void
+Model::applyCacheBudgets() noexcept
+{
+    size_t page_budget   = m_page_cache_budget;
+    size_t render_budget = m_render_cache_budget;
+
+    // Scale both budgets down to the share, keeping their ratio. A page
+    // cache without a byte budget only gets capped if there is no render
+    // cache to take the share.
+    if (m_memory_share > 0)
+    {
+        const double total = static_cast<double>(page_budget) + render_budget;
+        if (total == 0.0)
+            page_budget = m_memory_share;
+        else if (total > m_memory_share)
+        {
+            const double scale = m_memory_share / total;
+            page_budget        = static_cast<size_t>(page_budget * scale);
+            render_budget      = static_cast<size_t>(render_budget * scale);
+        }
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_page_cache_mutex);
+        m_page_lru_cache.setMaxWeight(page_budget > 0
+                                          ? page_budget
+                                          : std::numeric_limits<size_t>::max());
+    }
+
+    m_render_cache.setCapacity(render_budget > 0 ? RENDER_CACHE_MAX_ENTRIES
+                                                 : 0);
+    m_render_cache.setMaxWeight(render_budget);
+    if (render_budget == 0)
+        m_render_cache.clear();
+
+    shrinkStoreToShare();
+}
+
+// The store of decoded images and fonts is not part of either cache budget.
+// MuPDF does not tell its size, so it is shrunk by the fraction the document
+// is over its share.
+void
+Model::shrinkStoreToShare() noexcept
+{
+    const size_t usage = memoryUsage();
+    if (m_ctx && m_memory_share > 0 && usage > m_memory_share)
+        fz_shrink_store(m_ctx, static_cast<unsigned int>(
+                                   m_memory_share * 100 / usage));
+}
+
+size_t
+Model::memoryUsage() const noexcept
+{
+    // Display lists are MuPDF allocations, the page cache is already counted
+    return m_fz_bytes.load(std::memory_order_relaxed) + renderCacheBytes()
+           + textCacheBytes();
+}
+
+void
+Model::reportMemoryUsage() noexcept
+{
+    if (m_usage_report_pending.exchange(true))
+        return;
+
+    QMetaObject::invokeMethod(this, [this]()
+    {
+        m_usage_report_pending = false;
+        shrinkStoreToShare();
+        MemoryGovernor::instance().reportUsage(this);
+    }, Qt::QueuedConnection);
+}
+
+void
+Model::shedMemory() noexcept
+{
+    m_render_cache.clear();
+
     {
         std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
-        m_page_lru_cache.put(pageno, entry);
+        m_page_lru_cache.clear();
+    }
+
+    // Searches still running keep the pages they hold a snapshot of
+    m_text_cache.clear();
+
+    // Decoded images, fonts and the like kept by MuPDF for this document
+    if (m_ctx)
+        fz_shrink_store(m_ctx, 0);
+}
+
+size_t
+Model::pageCacheEntryBytes(fz_context *ctx,
+                           const PageCacheEntry &entry) noexcept
+{
+    size_t bytes = sizeof(PageCacheEntry);
+    if (entry.display_list)
+        bytes += displayListBytes(ctx, entry.display_list);
+    if (entry.links)
+    {
+        for (const auto &link : *entry.links)
+            bytes += sizeof(link) + link.uri.capacity() * sizeof(QChar);
+    }
+    if (entry.annotations)
+    {
+        for (const auto &annot : *entry.annotations)
+            bytes += sizeof(annot) + annot.text.capacity() * sizeof(QChar);
     }
+    return bytes;
 }
 
 bool
@@ -429,6 +865,8 @@ Model::setAnnotRectColor(const QColor &color) noexcept
 bool
 Model::decrypt() noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     // Use MuPDF to decrypt the PDF
     fz_try(m_ctx)
     {
@@ -500,6 +938,11 @@ Model::reloadDocument() noexcept
     if (filepath.isEmpty())
         return false;
 
+    // Searches read the document and fill the text cache, neither may
+    // outlive it
+    cancelSearch();
+    interruptDocumentSearch();
+    waitForSearches();
     waitForRenders();
 
     // Lock to prevent concurrent access
@@ -507,11 +950,12 @@ Model::reloadDocument() noexcept
 
     if (!m_ctx)
     {
-        m_ctx = fz_new_context(nullptr, &m_fz_locks, FZ_STORE_DEFAULT);
+        m_ctx = fz_new_context(&m_fz_alloc, &m_fz_locks, FZ_STORE_DEFAULT);
         if (!m_ctx)
             return false;
         fz_register_document_handlers(m_ctx);
         m_colorspace = fz_device_rgb(m_ctx);
+        m_ctx_pool.setBaseContext(m_ctx);
     }
 
     cleanup();
@@ -536,12 +980,16 @@ Model::reloadDocument() noexcept
     }
 
     m_success = ok;
+    if (ok)
+        openTextIndex();
     return ok;
 }
 
 bool
 Model::SaveChanges() noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     if (!m_doc || !m_pdf_doc)
         return false;
 
@@ -574,6 +1022,8 @@ Model::SaveChanges() noexcept
 bool
 Model::SaveAs(const QString &newFilePath) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     if (!m_doc || !m_pdf_doc)
         return false;
 
@@ -593,6 +1043,8 @@ Model::SaveAs(const QString &newFilePath) noexcept
 fz_outline *
 Model::getOutline() noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     if (!m_doc)
         return nullptr;
     if (!m_outline)
@@ -627,24 +1079,9 @@ Model::computeTextSelectionQuad(int pageno, const QPointF &devStart,
     // (scale+rotate+translate-to-(0,0)) ---
     const float scale = viewScale();
 
-    fz_rect page_bounds;
-    fz_page *page_for_bounds = nullptr;
-
-    fz_try(m_ctx)
-    {
-        page_for_bounds = fz_load_page(m_ctx, m_doc, pageno);
-        page_bounds     = fz_bound_page(m_ctx, page_for_bounds);
-    }
-    fz_always(m_ctx)
-    {
-        if (page_for_bounds)
-            fz_drop_page(m_ctx, page_for_bounds);
-    }
-    fz_catch(m_ctx)
-    {
-        qWarning() << "Selection failed (bounds):" << fz_caught_message(m_ctx);
+    const fz_rect page_bounds = pageBounds(pageno);
+    if (fz_is_empty_rect(page_bounds))
         return out;
-    }
 
     // page -> device
     fz_matrix page_to_dev = fz_scale(scale, scale);
@@ -674,6 +1111,9 @@ Model::computeTextSelectionQuad(int pageno, const QPointF &devStart,
     fz_page *page             = nullptr;
     int count                 = 0;
 
+    // Only the text extraction reads the document, the bounds are cached
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     fz_try(m_ctx)
     {
         page       = fz_load_page(m_ctx, m_doc, pageno);
@@ -725,6 +1165,8 @@ std::string
 Model::getSelectedText(int pageno, const fz_point &a, const fz_point &b,
                        bool formatted) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     std::string result;
     fz_page *page{nullptr};
     char *selection_text{nullptr};
@@ -762,6 +1204,8 @@ Model::getSelectedText(int pageno, const fz_point &a, const fz_point &b,
 std::vector<std::pair<QString, QString>>
 Model::properties() noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     std::vector<std::pair<QString, QString>> props;
     props.reserve(16); // Typical number of PDF properties
 
@@ -840,8 +1284,7 @@ fz_point
 Model::toPDFSpace(int pageno, QPointF pixelPos) const noexcept
 {
     // 1. Get the page bounds
-    fz_page *page  = fz_load_page(m_ctx, m_doc, pageno);
-    fz_rect bounds = fz_bound_page(m_ctx, page);
+    const fz_rect bounds = pageBounds(pageno);
 
     // 2. Re-create the same transform used in rendering
     // Must match the scale used in createRenderJob: m_zoom * m_dpr * m_dpi
@@ -871,9 +1314,6 @@ Model::toPDFSpace(int pageno, QPointF pixelPos) const noexcept
     fz_matrix inv_transform = fz_invert_matrix(transform);
     p                       = fz_transform_point(p, inv_transform);
 
-    // Clean up
-    fz_drop_page(m_ctx, page);
-
     return p;
 }
 
@@ -881,8 +1321,7 @@ QPointF
 Model::toPixelSpace(int pageno, fz_point p) const noexcept
 {
     // 1. Get the page bounds (identical to your render function)
-    fz_page *page  = fz_load_page(m_ctx, m_doc, pageno);
-    fz_rect bounds = fz_bound_page(m_ctx, page);
+    const fz_rect bounds = pageBounds(pageno);
 
     // 2. Re-create the same transform used in rendering
     const float scale
@@ -906,6 +1345,45 @@ Model::toPixelSpace(int pageno, fz_point p) const noexcept
     return QPointF(localX / m_dpr, localY / m_dpr);
 }
 
+fz_rect
+Model::pageBounds(int pageno) const noexcept
+{
+    {
+        std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+        const auto it = m_page_bounds.find(pageno);
+        if (it != m_page_bounds.end())
+            return it->second;
+    }
+
+    fz_rect bounds = fz_empty_rect;
+    {
+        std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+        if (!m_doc)
+            return bounds;
+
+        fz_page *page{nullptr};
+        fz_try(m_ctx)
+        {
+            page   = fz_load_page(m_ctx, m_doc, pageno);
+            bounds = fz_bound_page(m_ctx, page);
+        }
+        fz_always(m_ctx)
+        {
+            fz_drop_page(m_ctx, page);
+        }
+        fz_catch(m_ctx)
+        {
+            qWarning() << "Failed to bound page" << pageno << ":"
+                       << fz_caught_message(m_ctx);
+            return fz_empty_rect;
+        }
+    }
+
+    std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+    m_page_bounds[pageno] = bounds;
+    return bounds;
+}
+
 Model::RenderJob
 Model::createRenderJob(int pageno) const noexcept
 {
@@ -917,85 +1395,152 @@ Model::createRenderJob(int pageno) const noexcept
     job.zoom         = m_zoom * m_dpr * m_dpi;
     job.rotation     = m_rotation;
     job.invert_color = m_invert_color;
+    job.fg_color     = m_fg_color;
+    job.bg_color     = m_bg_color;
     job.colorspace   = m_colorspace;
     return job;
 }
 
-void
-Model::requestPageRender(
-    const RenderJob &job,
-    const std::function<void(PageRenderResult)> &callback) noexcept
+Model::RenderCacheKey
+Model::renderCacheKey(const RenderJob &job) noexcept
 {
-    // Ensure page is cached before rendering (lazy loading)
-    ensurePageCached(job.pageno);
+    RenderCacheKey key;
+    key.pageno       = job.pageno;
+    key.zoom         = job.zoom;
+    key.rotation     = job.rotation;
+    key.dpr          = job.dpr;
+    key.invert_color = job.invert_color;
+    key.fg_color     = job.fg_color;
+    key.bg_color     = job.bg_color;
+    key.raster_scale = job.raster_scale;
+    key.tile         = job.tile;
+    key.preview      = job.preview;
+    return key;
+}
 
-    m_render_future = QtConcurrent::run([this, job]() -> PageRenderResult
-    { return renderPageWithExtrasAsync(job); });
+const Model::PageRenderResult *
+Model::cachedPageRender(const RenderJob &job) noexcept
+{
+    return m_render_cache.get(renderCacheKey(job));
+}
 
-    auto watcher = new QFutureWatcher<PageRenderResult>();
+// Whether a job still matches the current view parameters, i.e. its output
+// can be shown as is
+bool
+Model::isRenderJobCurrent(const RenderJob &job) const noexcept
+{
+    return job.zoom == m_zoom * m_dpr * m_dpi && job.rotation == m_rotation
+           && job.dpr == m_dpr && job.invert_color == m_invert_color
+           && job.fg_color == m_fg_color && job.bg_color == m_bg_color;
+}
+
+void
+Model::requestPageRender(
+    const RenderJob &job,
+    const std::function<void(const PageRenderResult &)> &callback) noexcept
+{
+    QFuture<PageRenderResult> future
+        = QtConcurrent::run(&m_render_pool, [this, job]() -> PageRenderResult
+    { return renderPageWithExtrasAsync(job); });
+
+    // Pages edited while the job runs must not end up in the render cache
+    const uint64_t generation = m_render_cache_generation;
+
+    auto watcher = new QFutureWatcher<PageRenderResult>(this);
     connect(watcher, &QFutureWatcher<PageRenderResult>::finished,
-            [watcher, callback]()
+            [this, watcher, callback, job, generation]()
     {
-        PageRenderResult result = watcher->result();
+        // Only reference counts change hands from here on: the image is
+        // implicitly shared and links and annotations are snapshots
+        const PageRenderResult result = watcher->result();
         watcher->deleteLater();
 
+        if (!result.image.isNull() && generation == m_render_cache_generation)
+        {
+            size_t bytes = result.image.sizeInBytes();
+            if (result.links)
+                bytes += result.links->size() * sizeof(RenderLink);
+            if (result.annotations)
+                bytes += result.annotations->size() * sizeof(RenderAnnotation);
+            m_render_cache.put(renderCacheKey(job), result, bytes);
+            reportMemoryUsage();
+        }
+
         // on main thread
         if (callback)
             callback(result);
     });
 
-    watcher->setFuture(m_render_future);
+    watcher->setFuture(future);
 }
 
 Model::PageRenderResult
 Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
 {
     PageRenderResult result;
-    fz_context *ctx{nullptr};
+    fz_cookie *cookie = job.cookie.get();
 
-    // MuPDF context cloning must be thread-safe
-    {
-        static std::mutex clone_lock;
-        std::lock_guard<std::mutex> lock(clone_lock);
-        ctx = fz_clone_context(m_ctx);
-    }
+    // Cancelled while waiting in the pool
+    if (cookie && cookie->abort)
+        return result;
 
+    // The context goes back to the pool when the job ends, the image does
+    // not depend on it
+    FzContextPool::Lease lease(m_ctx_pool);
+    fz_context *ctx = lease.ctx();
     if (!ctx)
         return result;
 
-    // Copy cache entry data under lock to avoid race condition with
-    // invalidatePageCache. We keep a reference to the display list so it
-    // won't be freed while we're using it.
+    // Pooled contexts are reused across jobs, reset what previews change
+    fz_set_aa_level(ctx, job.preview ? PREVIEW_AA_BITS : m_aa_level.load());
+
+    // Interpret the page into a display list if it is not cached yet (lazy
+    // loading). This runs on the worker, never on the GUI thread.
+    ensurePageCached(ctx, job.pageno, cookie);
+    if (cookie && cookie->abort)
+        return result;
+
+    // Take references to the cache entry data under lock to avoid a race
+    // with invalidatePageCache. The display list and the snapshots stay
+    // valid while we use them even if the entry is dropped.
     fz_display_list *dlist{nullptr};
     fz_rect bounds{};
-    std::vector<CachedLink> links;
-    std::vector<CachedAnnotation> annotations;
+    LRUCache<int, PageCacheEntry>::Pin pin;
+    Snapshot<CachedLink> links;
+    Snapshot<CachedAnnotation> annotations;
 
     {
         std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
 
-        if (!m_page_lru_cache.has(job.pageno))
+        // ensurePageCached() already counted the lookup and refreshed it
+        const PageCacheEntry *entry = m_page_lru_cache.peek(job.pageno);
+        if (!entry)
         {
             qWarning() << "Model::PageRenderResult() Page not cached:"
                        << job.pageno;
-            fz_drop_context(ctx);
             return result;
         }
 
-        const PageCacheEntry *entry = m_page_lru_cache.get(job.pageno);
         if (!entry->display_list)
         {
             qWarning() << "Model::PageRenderResult() Missing display list for:"
                        << job.pageno;
-            fz_drop_context(ctx);
             return result;
         }
 
-        // Increment reference count so the display list stays valid
-        dlist       = fz_keep_display_list(ctx, entry->display_list);
-        bounds      = entry->bounds;
-        links       = entry->links;
-        annotations = entry->annotations;
+        // Increment reference count so the display list stays valid, and
+        // keep the entry cached for the tiles and renders that follow
+        dlist  = fz_keep_display_list(ctx, entry->display_list);
+        bounds = entry->bounds;
+        pin    = m_page_lru_cache.pin(job.pageno);
+
+        // Tiles and previews only carry pixels, links and annotations come
+        // with the full page render
+        if (job.tile.isEmpty() && !job.preview)
+        {
+            links       = entry->links;
+            annotations = entry->annotations;
+        }
     }
 
     fz_link *head{nullptr};
@@ -1003,6 +1548,9 @@ Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
     fz_device *dev{nullptr};
     fz_page *text_page{nullptr};
     fz_stext_page *stext_page{nullptr};
+    QImage image;
+    std::vector<RenderLink> render_links;
+    std::vector<RenderAnnotation> render_annots;
 
     fz_try(ctx)
     {
@@ -1010,65 +1558,76 @@ Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
         fz_rect transformed = fz_transform_rect(bounds, transform);
         fz_irect bbox       = fz_round_rect(transformed);
 
-        // --- Render page to QImage ---
-        pix = fz_new_pixmap_with_bbox(ctx, job.colorspace, bbox, nullptr, 1);
-        fz_clear_pixmap_with_value(ctx, pix, 255);
-
-        dev = fz_new_draw_device(ctx, fz_identity, pix);
-        fz_run_display_list(ctx, dlist, dev, transform,
-                            fz_rect_from_irect(bbox), nullptr);
-
-        static const int fg = (m_fg_color >> 8) & 0xFFFFFF;
-        static const int bg = (m_bg_color >> 8) & 0xFFFFFF;
-        fz_tint_pixmap(ctx, pix, fg, bg);
-
-        if (job.invert_color)
+        fz_matrix raster_transform = transform;
+        fz_irect raster_bbox       = bbox;
+        if (job.raster_scale != 1.0)
         {
-            fz_invert_pixmap_luminance(ctx, pix);
+            raster_transform = fz_transform_page(
+                bounds, job.zoom * job.raster_scale, job.rotation);
+            raster_bbox
+                = fz_round_rect(fz_transform_rect(bounds, raster_transform));
         }
-        fz_gamma_pixmap(ctx, pix, 1.0f);
-
-        int width  = fz_pixmap_width(ctx, pix);
-        int height = fz_pixmap_height(ctx, pix);
-        int n      = fz_pixmap_components(ctx, pix);
-        int stride = fz_pixmap_stride(ctx, pix);
-
-        unsigned char *samples = fz_pixmap_samples(ctx, pix);
-        if (!samples)
-            return result;
 
-        QImage::Format fmt;
-        switch (n)
+        // Only the tile is allocated, and the display list culls everything
+        // outside of it
+        if (!job.tile.isEmpty())
         {
-            case 1:
-                fmt = QImage::Format_Grayscale8;
-                break;
-            case 3:
-                fmt = QImage::Format_RGB888;
-                break;
-            case 4:
-                fmt = QImage::Format_RGBA8888;
-                break;
-
-            default:
-            {
-                qWarning() << "Unsupported pixmap component count:" << n;
-                return result;
-            }
+            const int x0        = raster_bbox.x0 + job.tile.left();
+            const int y0        = raster_bbox.y0 + job.tile.top();
+            const fz_irect tile = fz_make_irect(
+                x0, y0, x0 + job.tile.width(), y0 + job.tile.height());
+            raster_bbox = fz_intersect_irect(raster_bbox, tile);
+            if (fz_is_empty_irect(raster_bbox))
+                fz_throw(ctx, FZ_ERROR_GENERIC, "Tile outside of page %d",
+                         job.pageno);
         }
 
-        RenderPayload *payload = new RenderPayload{ctx, pix};
+        // --- Render page to QImage ---
+        // MuPDF draws straight into the image memory, so the result needs
+        // neither a copy nor the context to stay alive
+        if (fz_colorspace_n(ctx, job.colorspace) != 3)
+            fz_throw(ctx, FZ_ERROR_GENERIC, "Unsupported colorspace");
+
+        image = QImage(raster_bbox.x1 - raster_bbox.x0,
+                       raster_bbox.y1 - raster_bbox.y0,
+                       QImage::Format_RGBA8888);
+        if (image.isNull())
+            fz_throw(ctx, FZ_ERROR_GENERIC, "Cannot allocate page %d",
+                     job.pageno);
+
+        pix = fz_new_pixmap_with_bbox_and_data(ctx, job.colorspace,
+                                               raster_bbox, nullptr, 1,
+                                               image.bits());
+        fz_clear_pixmap_with_value(ctx, pix, 255);
 
-        result.image = QImage(samples, width, height, stride, fmt,
-                              imageCleanupHandler, payload);
+        dev = fz_new_draw_device(ctx, fz_identity, pix);
+        fz_run_display_list(ctx, dlist, dev, raster_transform,
+                            fz_rect_from_irect(raster_bbox), cookie);
+
+        // Stopped halfway, the pixmap is incomplete
+        if (cookie && cookie->abort)
+            fz_throw(ctx, FZ_ERROR_ABORT, "Aborted rendering page %d",
+                     job.pageno);
+
+        // Tint, inversion and gamma in one sweep over the pixels
+        const PixelTransform post((job.fg_color >> 8) & 0xFFFFFF,
+                                  (job.bg_color >> 8) & 0xFFFFFF,
+                                  job.invert_color, 1.0f);
+        post.apply(fz_pixmap_samples(ctx, pix),
+                   static_cast<size_t>(fz_pixmap_width(ctx, pix))
+                       * fz_pixmap_height(ctx, pix));
+
+        result.image = std::move(image);
         result.image.setDotsPerMeterX(
             static_cast<int>((job.dpi * 1000) / 25.4));
         result.image.setDotsPerMeterY(
             static_cast<int>((job.dpi * 1000) / 25.4));
-        result.image.setDevicePixelRatio(job.dpr);
+        result.image.setDevicePixelRatio(job.dpr * job.raster_scale);
 
         // --- Extract links ---
-        for (const auto &link : links)
+        const std::vector<CachedLink> &page_links = snapshotItems(links);
+        render_links.reserve(page_links.size());
+        for (const auto &link : page_links)
         {
             if (link.uri.isEmpty())
                 continue;
@@ -1097,15 +1656,31 @@ Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
                     link.target_loc.x, link.target_loc.y, link.zoom};
             }
 
-            result.links.push_back(std::move(renderLink));
+            render_links.push_back(std::move(renderLink));
         }
 
-        if (m_detect_url_links)
+        if (m_detect_url_links && job.tile.isEmpty() && !job.preview)
         {
-            text_page = fz_load_page(ctx, m_doc, job.pageno);
-            if (text_page)
-                stext_page
-                    = fz_new_stext_page_from_page(ctx, text_page, nullptr);
+            // The document itself is not thread-safe, only one worker may
+            // load pages from it at a time
+            m_doc_mutex.lock();
+            fz_try(ctx)
+            {
+                text_page = fz_load_page(ctx, m_doc, job.pageno);
+                if (text_page)
+                    stext_page
+                        = fz_new_stext_page_from_page(ctx, text_page, nullptr);
+            }
+            fz_always(ctx)
+            {
+                fz_drop_page(ctx, text_page);
+                text_page = nullptr;
+                m_doc_mutex.unlock();
+            }
+            fz_catch(ctx)
+            {
+                fz_rethrow(ctx);
+            }
 
             if (stext_page)
             {
@@ -1113,7 +1688,7 @@ Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
 
                 auto hasIntersectingLink = [&](const fz_rect &r) -> bool
                 {
-                    for (const auto &link : links)
+                    for (const auto &link : page_links)
                     {
                         const fz_rect lr = link.rect;
                         if (r.x1 < lr.x0 || r.x0 > lr.x1 || r.y1 < lr.y0
@@ -1190,14 +1765,17 @@ Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
                             renderLink.type
                                 = BrowseLinkItem::LinkType::External;
                             renderLink.boundary = m_link_show_boundary;
-                            result.links.push_back(std::move(renderLink));
+                            render_links.push_back(std::move(renderLink));
                         }
                     }
                 }
             }
         }
 
-        for (const auto &annot : annotations)
+        const std::vector<CachedAnnotation> &page_annots
+            = snapshotItems(annotations);
+        render_annots.reserve(page_annots.size());
+        for (const auto &annot : page_annots)
         {
             RenderAnnotation renderAnnot;
 
@@ -1210,13 +1788,22 @@ Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
             renderAnnot.index = annot.index;
             renderAnnot.color = annot.color;
             renderAnnot.text  = annot.text;
-            result.annotations.push_back(std::move(renderAnnot));
+            render_annots.push_back(std::move(renderAnnot));
         }
+
+        if (!render_links.empty())
+            result.links = std::make_shared<const std::vector<RenderLink>>(
+                std::move(render_links));
+        if (!render_annots.empty())
+            result.annotations
+                = std::make_shared<const std::vector<RenderAnnotation>>(
+                    std::move(render_annots));
     }
     fz_always(ctx)
     {
         fz_close_device(ctx, dev);
         fz_drop_device(ctx, dev);
+        fz_drop_pixmap(ctx, pix);
         fz_drop_link(ctx, head);
         fz_drop_display_list(ctx, dlist);
         if (stext_page)
@@ -1226,8 +1813,15 @@ Model::renderPageWithExtrasAsync(const RenderJob &job) noexcept
     }
     fz_catch(ctx)
     {
-        qWarning() << "MuPDF error in thread:" << fz_caught_message(ctx);
-        fz_drop_pixmap(ctx, pix);
+        if (fz_caught(ctx) != FZ_ERROR_ABORT)
+            qWarning() << "MuPDF error in thread:" << fz_caught_message(ctx);
+
+        result = PageRenderResult{};
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+        m_page_lru_cache.unpin(pin);
     }
 
     return result;
@@ -1244,25 +1838,31 @@ Model::highlightTextSelection(int pageno, const QPointF &start,
     int count = 0;
     fz_stext_page *stext_page{nullptr};
 
-    fz_try(m_ctx)
     {
-        page = fz_load_page(m_ctx, m_doc, pageno);
+        // Released before the command is pushed, redo() locks it again
+        std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
 
-        stext_page = fz_new_stext_page_from_page(m_ctx, page, nullptr);
+        fz_try(m_ctx)
+        {
+            page = fz_load_page(m_ctx, m_doc, pageno);
 
-        fz_point a, b;
-        a     = {static_cast<float>(start.x()), static_cast<float>(start.y())};
-        b     = {static_cast<float>(end.x()), static_cast<float>(end.y())};
-        count = fz_highlight_selection(m_ctx, stext_page, a, b, hits, MAX_HITS);
-    }
-    fz_always(m_ctx)
-    {
-        fz_drop_page(m_ctx, page);
-        fz_drop_stext_page(m_ctx, stext_page);
-    }
-    fz_catch(m_ctx)
-    {
-        qWarning() << "Failed to copy selection text";
+            stext_page = fz_new_stext_page_from_page(m_ctx, page, nullptr);
+
+            fz_point a, b;
+            a = {static_cast<float>(start.x()), static_cast<float>(start.y())};
+            b = {static_cast<float>(end.x()), static_cast<float>(end.y())};
+            count = fz_highlight_selection(m_ctx, stext_page, a, b, hits,
+                                           MAX_HITS);
+        }
+        fz_always(m_ctx)
+        {
+            fz_drop_page(m_ctx, page);
+            fz_drop_stext_page(m_ctx, stext_page);
+        }
+        fz_catch(m_ctx)
+        {
+            qWarning() << "Failed to copy selection text";
+        }
     }
 
     // Collect quads for the command
@@ -1281,6 +1881,8 @@ int
 Model::addHighlightAnnotation(const int pageno,
                               const std::vector<fz_quad> &quads) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     int objNum{-1};
 
     fz_try(m_ctx)
@@ -1314,20 +1916,9 @@ Model::addHighlightAnnotation(const int pageno,
         pdf_drop_annot(m_ctx, annot);
         pdf_drop_page(m_ctx, page);
 
-        {
-            std::lock_guard<std::recursive_mutex> cache_lock(
-                m_page_cache_mutex);
-            if (m_page_lru_cache.has(pageno))
-            {
-                // fz_drop_display_list(m_ctx,
-                // m_page_cache[pageno].display_list);
-                // m_page_cache.erase(pageno);
-                m_page_lru_cache.remove(pageno);
-            }
-        }
-        // Build cache outside the lock to avoid holding it during expensive
-        // operations
-        buildPageCache(pageno);
+        // The display list is rebuilt lazily by the next render, off the
+        // GUI thread
+        invalidatePageCache(pageno);
     }
     fz_catch(m_ctx)
     {
@@ -1344,6 +1935,8 @@ Model::addHighlightAnnotation(const int pageno,
 int
 Model::addRectAnnotation(const int pageno, const fz_rect &rect) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     int objNum{-1};
 
     fz_try(m_ctx)
@@ -1374,20 +1967,9 @@ Model::addRectAnnotation(const int pageno, const fz_rect &rect) noexcept
         pdf_drop_annot(m_ctx, annot);
         pdf_drop_page(m_ctx, page);
 
-        {
-            std::lock_guard<std::recursive_mutex> cache_lock(
-                m_page_cache_mutex);
-            if (m_page_lru_cache.has(pageno))
-            {
-                m_page_lru_cache.remove(pageno);
-                // fz_drop_display_list(m_ctx,
-                // m_page_cache[pageno].display_list);
-                // m_page_cache.erase(pageno);
-            }
-        }
-        // Build cache outside the lock to avoid holding it during expensive
-        // operations
-        buildPageCache(pageno);
+        // The display list is rebuilt lazily by the next render, off the
+        // GUI thread
+        invalidatePageCache(pageno);
     }
     fz_catch(m_ctx)
     {
@@ -1405,6 +1987,8 @@ int
 Model::addTextAnnotation(const int pageno, const fz_rect &rect,
                          const QString &text) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     int objNum{-1};
 
     fz_try(m_ctx)
@@ -1445,20 +2029,9 @@ Model::addTextAnnotation(const int pageno, const fz_rect &rect,
         pdf_drop_annot(m_ctx, annot);
         pdf_drop_page(m_ctx, page);
 
-        {
-            std::lock_guard<std::recursive_mutex> cache_lock(
-                m_page_cache_mutex);
-            if (m_page_lru_cache.has(pageno))
-            {
-                // fz_drop_display_list(m_ctx,
-                // m_page_cache[pageno].display_list);
-                // m_page_cache.erase(pageno);
-                m_page_lru_cache.remove(pageno);
-            }
-        }
-        // Build cache outside the lock to avoid holding it during expensive
-        // operations
-        buildPageCache(pageno);
+        // The display list is rebuilt lazily by the next render, off the
+        // GUI thread
+        invalidatePageCache(pageno);
     }
     fz_catch(m_ctx)
     {
@@ -1476,6 +2049,8 @@ void
 Model::setTextAnnotationContents(const int pageno, const int objNum,
                                  const QString &text) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     fz_try(m_ctx)
     {
         pdf_page *page = pdf_load_page(m_ctx, m_pdf_doc, pageno);
@@ -1498,18 +2073,9 @@ Model::setTextAnnotationContents(const int pageno, const int objNum,
 
         pdf_drop_page(m_ctx, page);
 
-        {
-            std::lock_guard<std::recursive_mutex> cache_lock(
-                m_page_cache_mutex);
-            if (m_page_lru_cache.has(pageno))
-            {
-                // fz_drop_display_list(m_ctx,
-                // m_page_cache[pageno].display_list);
-                // m_page_cache.erase(pageno);
-                m_page_lru_cache.remove(pageno);
-            }
-        }
-        buildPageCache(pageno);
+        // The display list is rebuilt lazily by the next render, off the
+        // GUI thread
+        invalidatePageCache(pageno);
     }
     fz_catch(m_ctx)
     {
@@ -1539,6 +2105,8 @@ Model::setUrlLinkRegex(const QString &pattern) noexcept
 void
 Model::removeAnnotations(int pageno, const std::vector<int> &objNums) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     if (objNums.empty())
         return;
 
@@ -1602,6 +2170,7 @@ void
 Model::invalidatePageCache(int pageno) noexcept
 {
     std::lock_guard<std::recursive_mutex> cache_lock(m_page_cache_mutex);
+    ++m_page_cache_generation;
     if (m_page_lru_cache.has(pageno))
     {
         // fz_drop_display_list(m_ctx, m_page_cache[pageno].display_list);
@@ -1610,6 +2179,10 @@ Model::invalidatePageCache(int pageno) noexcept
 
         // buildPageCache(pageno);
     }
+
+    ++m_render_cache_generation;
+    m_render_cache.removeIf([pageno](const RenderCacheKey &key)
+    { return key.pageno == pageno; });
 }
 
 std::vector<QPolygonF>
@@ -1622,24 +2195,9 @@ Model::selectWordAt(int pageno, fz_point pt) noexcept
 
     const float scale = viewScale();
 
-    fz_rect page_bounds{};
-    fz_page *page_for_bounds = nullptr;
-
-    fz_try(m_ctx)
-    {
-        page_for_bounds = fz_load_page(m_ctx, m_doc, pageno);
-        page_bounds     = fz_bound_page(m_ctx, page_for_bounds);
-    }
-    fz_always(m_ctx)
-    {
-        if (page_for_bounds)
-            fz_drop_page(m_ctx, page_for_bounds);
-    }
-    fz_catch(m_ctx)
-    {
-        qWarning() << "Selection failed (bounds):" << fz_caught_message(m_ctx);
+    const fz_rect page_bounds = pageBounds(pageno);
+    if (fz_is_empty_rect(page_bounds))
         return out;
-    }
 
     fz_matrix page_to_dev    = fz_scale(scale, scale);
     page_to_dev              = fz_pre_rotate(page_to_dev, m_rotation);
@@ -1657,6 +2215,8 @@ Model::selectWordAt(int pageno, fz_point pt) noexcept
     fz_page *page{nullptr};
     int count = 0;
 
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     fz_try(m_ctx)
     {
         page       = fz_load_page(m_ctx, m_doc, pageno);
@@ -1708,24 +2268,9 @@ Model::selectLineAt(int pageno, fz_point pt) noexcept
 
     const float scale = viewScale();
 
-    fz_rect page_bounds{};
-    fz_page *page_for_bounds = nullptr;
-
-    fz_try(m_ctx)
-    {
-        page_for_bounds = fz_load_page(m_ctx, m_doc, pageno);
-        page_bounds     = fz_bound_page(m_ctx, page_for_bounds);
-    }
-    fz_always(m_ctx)
-    {
-        if (page_for_bounds)
-            fz_drop_page(m_ctx, page_for_bounds);
-    }
-    fz_catch(m_ctx)
-    {
-        qWarning() << "Selection failed (bounds):" << fz_caught_message(m_ctx);
+    const fz_rect page_bounds = pageBounds(pageno);
+    if (fz_is_empty_rect(page_bounds))
         return out;
-    }
 
     fz_matrix page_to_dev    = fz_scale(scale, scale);
     page_to_dev              = fz_pre_rotate(page_to_dev, m_rotation);
@@ -1743,6 +2288,8 @@ Model::selectLineAt(int pageno, fz_point pt) noexcept
     fz_page *page{nullptr};
     int count = 0;
 
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     fz_try(m_ctx)
     {
         page       = fz_load_page(m_ctx, m_doc, pageno);
@@ -1794,24 +2341,9 @@ Model::selectParagraphAt(int pageno, fz_point pt) noexcept
 
     const float scale = viewScale();
 
-    fz_rect page_bounds{};
-    fz_page *page_for_bounds = nullptr;
-
-    fz_try(m_ctx)
-    {
-        page_for_bounds = fz_load_page(m_ctx, m_doc, pageno);
-        page_bounds     = fz_bound_page(m_ctx, page_for_bounds);
-    }
-    fz_always(m_ctx)
-    {
-        if (page_for_bounds)
-            fz_drop_page(m_ctx, page_for_bounds);
-    }
-    fz_catch(m_ctx)
-    {
-        qWarning() << "Selection failed (bounds):" << fz_caught_message(m_ctx);
+    const fz_rect page_bounds = pageBounds(pageno);
+    if (fz_is_empty_rect(page_bounds))
         return out;
-    }
 
     fz_matrix page_to_dev    = fz_scale(scale, scale);
     page_to_dev              = fz_pre_rotate(page_to_dev, m_rotation);
@@ -1825,6 +2357,8 @@ Model::selectParagraphAt(int pageno, fz_point pt) noexcept
     fz_stext_page *stext_page{nullptr};
     fz_page *page{nullptr};
 
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     fz_try(m_ctx)
     {
         page       = fz_load_page(m_ctx, m_doc, pageno);
@@ -1883,85 +2417,411 @@ Model::selectParagraphAt(int pageno, fz_point pt) noexcept
 }
 
 void
-Model::search(const QString &term, bool caseSensitive) noexcept
+Model::search(const QString &term, const SearchQuery::Options &options,
+              int startPage) noexcept
 {
-    QFuture<void> result = QtConcurrent::run([this, term, caseSensitive]()
+    // Compiled once, shared read-only by all workers
+    const auto query = std::make_shared<const SearchQuery>(term, options);
+    if (!query->isValid())
     {
-        QMap<int, std::vector<Model::SearchHit>> results;
-        m_search_match_count = 0;
+        cancelSearch();
+        emit searchFailed(query->errorString());
+        return;
+    }
+
+    const bool private_docs = canSearchPrivately();
+
+    // Saved text of the file on disk, which is what private copies read
+    const std::shared_ptr<const TextIndex> index
+        = private_docs ? textIndex() : nullptr;
 
-        if (term.isEmpty())
+    const uint64_t generation = ++m_search_generation;
+    // Read here, reloadDocument() changes it on the GUI thread
+    const int page_count = m_page_count;
+
+    trackSearch(QtConcurrent::run([this, query, page_count, private_docs, index,
+                                   startPage, generation]()
+    {
+        // Checked before every page, a newer search or cancelSearch() bumps
+        // the generation
+        auto cancelled = [this, generation]()
+        { return generation != m_search_generation.load(); };
+
+        // Runs on the GUI thread, where the generation is bumped, so nothing
+        // queued by a superseded search gets through
+        auto deliver
+            = [this, generation](QMap<int, std::vector<SearchHit>> &&hits)
         {
-            emit searchResultsReady(results);
+            QMetaObject::invokeMethod(
+                this, [this, generation, hits = std::move(hits)]()
+            {
+                if (generation == m_search_generation)
+                    emit searchResultsReady(hits);
+            }, Qt::QueuedConnection);
+        };
+
+        const int count = runSearch(*query, page_count, private_docs, index,
+                                    startPage, cancelled, deliver);
+        if (cancelled())
             return;
-        }
 
-        for (int p = 0; p < m_page_count; ++p)
+        QMetaObject::invokeMethod(this, [this, generation, count]()
+        {
+            if (generation != m_search_generation)
+                return;
+            m_search_match_count = count;
+            emit searchFinished(count);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void
+Model::searchDocument(
+    std::shared_ptr<const SearchQuery> query,
+    std::function<void(const QMap<int, std::vector<SearchHit>> &)> onResults,
+    std::function<void(int)> onFinished) noexcept
+{
+    const uint64_t generation = ++m_document_search_generation;
+
+    // A suspended document is closed until its view comes back
+    if (!m_doc || !query || !query->isValid())
+    {
+        QMetaObject::invokeMethod(this, [this, generation, onFinished]()
+        {
+            if (generation == m_document_search_generation)
+                onFinished(0);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    const bool private_docs = canSearchPrivately();
+    const std::shared_ptr<const TextIndex> index
+        = private_docs ? textIndex() : nullptr;
+
+    const int page_count = m_page_count;
+
+    m_document_search_finished = onFinished;
+    m_document_search_future   = QtConcurrent::run(
+        [this, query, page_count, private_docs, index, generation, onResults,
+         onFinished]()
+    {
+        auto cancelled = [this, generation]()
+        { return generation != m_document_search_generation.load(); };
+
+        auto deliver = [this, generation,
+                        onResults](QMap<int, std::vector<SearchHit>> &&hits)
         {
-            auto hits = searchHelper(p, term, caseSensitive);
-            if (!hits.empty())
+            QMetaObject::invokeMethod(
+                this, [this, generation, onResults, hits = std::move(hits)]()
             {
-                m_search_match_count += hits.size();
-                results.insert(p, std::move(hits));
-            }
-        }
-        emit searchResultsReady(results);
+                if (generation == m_document_search_generation)
+                    onResults(hits);
+            }, Qt::QueuedConnection);
+        };
+
+        const int count = runSearch(*query, page_count, private_docs, index,
+                                    0, cancelled, deliver);
+        if (cancelled())
+            return;
+
+        QMetaObject::invokeMethod(this, [this, generation, onFinished, count]()
+        {
+            if (generation != m_document_search_generation)
+                return;
+            m_document_search_finished = nullptr;
+            onFinished(count);
+        }, Qt::QueuedConnection);
     });
+    trackSearch(m_document_search_future);
 }
 
-std::vector<Model::SearchHit>
-Model::searchHelper(int pageno, const QString &term,
-                    bool caseSensitive) noexcept
+void
+Model::cancelDocumentSearch() noexcept
 {
-    std::vector<SearchHit> results;
+    ++m_document_search_generation;
+}
 
-    if (term.isEmpty())
-        return results;
+// Whoever asked for the document search is told it is over, with no more
+// hits than it got so far
+void
+Model::interruptDocumentSearch() noexcept
+{
+    cancelDocumentSearch();
+    if (std::function<void(int)> finished
+        = std::exchange(m_document_search_finished, nullptr))
+        finished(0);
+}
 
-    buildTextCacheForPage(pageno);
+void
+Model::trackSearch(const QFuture<void> &future) noexcept
+{
+    m_search_futures.erase(std::remove_if(m_search_futures.begin(),
+                                          m_search_futures.end(),
+                                          [](const QFuture<void> &f)
+    { return f.isFinished(); }), m_search_futures.end());
+    m_search_futures.push_back(future);
+}
 
-    auto it = m_text_cache.find(pageno);
-    if (it == m_text_cache.end())
-        return results;
+void
+Model::waitForSearches() noexcept
+{
+    for (QFuture<void> &future : m_search_futures)
+        future.waitForFinished();
+    m_search_futures.clear();
+}
 
-    const auto &text = it->second.chars;
-    const int n      = text.size();
-    const int m      = term.size();
+bool
+Model::canSearchPrivately() const noexcept
+{
+    // Private copies of the document let the workers extract text in
+    // parallel, unless they would not read the same text as the open one
+    return m_doc && !hasUnsavedChanges() && !passwordRequired()
+           && !fz_is_document_reflowable(m_ctx, m_doc);
+}
 
-    if (n < m)
-        return results;
+QThreadPool &
+Model::searchPool() noexcept
+{
+    static QThreadPool pool;
+    return pool;
+}
 
-    // Convert search term once
-    std::vector<uint32_t> pattern;
-    pattern.reserve(m);
-    for (QChar c : term)
-        pattern.push_back(c.unicode());
+int
+Model::runSearch(
+    const SearchQuery &query, int pageCount, bool private_docs,
+    const std::shared_ptr<const TextIndex> &index, int startPage,
+    const std::function<bool()> &cancelled,
+    const std::function<void(QMap<int, std::vector<SearchHit>> &&)> &deliver)
+    noexcept
+{
+    if (query.isEmpty() || pageCount == 0)
+        return 0;
+
+    const TextIndex::Trigrams trigrams
+        = index ? TextIndex::trigrams(query.requiredText())
+                : TextIndex::Trigrams{};
+
+    // Runs of consecutive pages, the one holding startPage first, then
+    // alternately the next one after and before it
+    const int chunk_count
+        = (pageCount + SEARCH_CHUNK_PAGES - 1) / SEARCH_CHUNK_PAGES;
+    const int home
+        = std::clamp(startPage, 0, pageCount - 1) / SEARCH_CHUNK_PAGES;
+    std::vector<int> chunks;
+    chunks.reserve(chunk_count);
+    chunks.push_back(home);
+    for (int d = 1; static_cast<int>(chunks.size()) < chunk_count; ++d)
+    {
+        if (home + d < chunk_count)
+            chunks.push_back(home + d);
+        if (home - d >= 0)
+            chunks.push_back(home - d);
+    }
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<int> match_count{0};
+
+    // Hits found but not handed out yet. The first batch goes out at once,
+    // later ones are coalesced to spare the GUI thread.
+    std::mutex batch_mutex;
+    QMap<int, std::vector<SearchHit>> batch;
+    QElapsedTimer since_batch;
+    bool first_batch = true;
+
+    auto flush = [&](bool force)
+    {
+        if (batch.isEmpty()
+            || (!force && !first_batch
+                && since_batch.elapsed() < SEARCH_BATCH_MS))
+            return;
+
+        deliver(std::move(batch));
+        batch.clear();
+        since_batch.start();
+        first_batch = false;
+    };
 
-    for (int i = 0; i <= n - m; ++i)
+    auto worker = [&]()
     {
-        bool match = true;
+        FzContextPool::Lease lease(m_ctx_pool);
+        fz_context *ctx = lease.ctx();
+        if (!ctx)
+            return;
 
-        for (int j = 0; j < m; ++j)
+        PrivateDocument doc{ctx};
+        for (size_t c = next_chunk++; c < chunks.size() && !cancelled();
+             c        = next_chunk++)
         {
-            if (!charEqual(text[i + j].rune, pattern[j], caseSensitive))
+            const int first = chunks[c] * SEARCH_CHUNK_PAGES;
+            const int last = std::min(first + SEARCH_CHUNK_PAGES, pageCount);
+
+            QMap<int, std::vector<SearchHit>> found;
+            for (int p = first; p < last && !cancelled(); ++p)
             {
-                match = false;
-                break;
+                auto hits = index
+                                ? searchIndexedPage(p, *index, trigrams, query)
+                                : searchHelper(p, query,
+                                               private_docs ? &doc : nullptr);
+                if (hits.empty())
+                    continue;
+                match_count += hits.size();
+                found.insert(p, std::move(hits));
             }
+
+            if (found.isEmpty() || cancelled())
+                continue;
+
+            std::lock_guard<std::mutex> lock(batch_mutex);
+            batch.insert(found);
+            flush(false);
         }
+        fz_drop_document(ctx, doc.doc);
+    };
 
-        if (!match)
-            continue;
+    // This thread is one of the workers
+    const int workers = std::min(searchPool().maxThreadCount(), chunk_count);
+    std::vector<QFuture<void>> futures;
+    for (int i = 1; i < workers; ++i)
+        futures.push_back(QtConcurrent::run(&searchPool(), worker));
+    worker();
+    for (QFuture<void> &future : futures)
+        future.waitForFinished();
+
+    if (!cancelled())
+        flush(true);
+    return match_count;
+}
+
+void
+Model::cancelSearch() noexcept
+{
+    ++m_search_generation;
+}
+
+// Opened on ctx, which the calling worker keeps leased while it uses the
+// copy. nullptr if the file cannot be opened or no longer matches.
+fz_document *
+Model::openSearchDocument(fz_context *ctx) const noexcept
+{
+    fz_document *doc{nullptr};
+
+    fz_try(ctx)
+    {
+        doc = fz_open_document(ctx, CSTR(m_filepath));
+        if (fz_count_pages(ctx, doc) != m_page_count)
+            fz_throw(ctx, FZ_ERROR_GENERIC, "Changed on disk");
+    }
+    fz_catch(ctx)
+    {
+        fz_drop_document(ctx, doc);
+        doc = nullptr;
+    }
 
+    return doc;
+}
+
+fz_document *
+Model::privateDocument(PrivateDocument *doc) const noexcept
+{
+    if (!doc)
+        return nullptr;
+
+    if (!doc->opened)
+    {
+        doc->opened = true;
+        doc->doc    = openSearchDocument(doc->ctx);
+    }
+    return doc->doc;
+}
+
+QString
+Model::searchHitContext(const SearchHit &hit, int radius) noexcept
+{
+    std::u16string_view chars;
+    const TextCache::TextRef text = m_text_cache.text(hit.page);
+    const std::shared_ptr<const TextIndex> index = textIndex();
+    if (text)
+        chars = text->chars;
+    else if (index)
+        chars = index->chars(hit.page);
+
+    const size_t start = static_cast<size_t>(std::max(hit.index, 0));
+    if (start >= chars.size())
+        return QString();
+
+    const size_t first = start > static_cast<size_t>(radius) ? start - radius
+                                                             : 0;
+    const size_t last  = std::min(chars.size(), start + hit.length + radius);
+    const QString context
+        = QString::fromUtf16(chars.data() + first,
+                             static_cast<qsizetype>(last - first));
+    return context.simplified();
+}
+
+std::vector<Model::SearchHit>
+Model::searchHelper(int pageno, const SearchQuery &query,
+                    PrivateDocument *doc) noexcept
+{
+    if (query.isEmpty())
+        return {};
+
+    // Pages already cached never open the private document
+    TextCache::TextRef page_text = m_text_cache.text(pageno);
+    if (!page_text)
+        page_text = pageText(pageno, privateDocument(doc));
+    if (!page_text)
+        return {};
+
+    std::vector<SearchQuery::Match> matches;
+    query.findAll(page_text->chars, page_text->folded, matches);
+    if (matches.empty())
+        return {};
+
+    // Only pages with hits need character boxes
+    TextCache::GeometryRef geometry = m_text_cache.geometry(pageno);
+    if (!geometry)
+        geometry = pageTextGeometry(pageno, privateDocument(doc));
+    if (!geometry)
+        return {};
+
+    return placeSearchHits(pageno, matches, *geometry);
+}
+
+std::vector<Model::SearchHit>
+Model::searchIndexedPage(int pageno, const TextIndex &index,
+                         const TextIndex::Trigrams &trigrams,
+                         const SearchQuery &query) noexcept
+{
+    if (query.isEmpty() || !index.mayContain(pageno, trigrams))
+        return {};
+
+    // Scanned in place, nothing is copied for pages without hits
+    std::vector<SearchQuery::Match> matches;
+    query.findAll(index.chars(pageno), index.folded(pageno), matches);
+    if (matches.empty())
+        return {};
+
+    TextCache::GeometryRef geometry = m_text_cache.geometry(pageno);
+    if (!geometry)
+    {
+        geometry = m_text_cache.putGeometry(pageno, index.geometry(pageno));
+        reportMemoryUsage();
+    }
+
+    return placeSearchHits(pageno, matches, *geometry);
+}
+
+std::vector<Model::SearchHit>
+Model::placeSearchHits(int pageno,
+                       const std::vector<SearchQuery::Match> &matches,
+                       const TextCache::Geometry &geometry) noexcept
+{
+    std::vector<SearchHit> results;
+    results.reserve(matches.size());
+
+    for (const SearchQuery::Match &match : matches)
+    {
         // Compute **single quad for entire match**
-        fz_rect bbox = fz_empty_rect;
-        for (int j = 0; j < m; ++j)
-        {
-            if (!fz_is_empty_quad(text[i + j].quad))
-            {
-                bbox = fz_union_rect(bbox, fz_rect_from_quad(text[i + j].quad));
-            }
-        }
+        const fz_rect bbox = geometry.rangeRect(match.start, match.length);
 
         if (!fz_is_empty_rect(bbox))
         {
@@ -1971,7 +2831,8 @@ Model::searchHelper(int pageno, const QString &term,
                         {bbox.x1, bbox.y0},
                         {bbox.x0, bbox.y1},
                         {bbox.x0, bbox.y0}},
-                i // index of first character in match
+                static_cast<int>(match.start), // index of first character
+                static_cast<int>(match.length)
             });
         }
     }
@@ -1987,41 +2848,49 @@ Model::collectHighlightTexts(bool groupByLine) noexcept
     if (!m_ctx || !m_doc || !m_pdf_doc)
         return results;
 
+    // Runs on a worker, which must not share the GUI thread's m_ctx
+    FzContextPool::Lease lease(m_ctx_pool);
+    fz_context *ctx = lease.ctx();
+    if (!ctx)
+        return results;
+
     for (int pageno = 0; pageno < m_page_count; ++pageno)
     {
+        // Lock per page so renders can interleave with a long scan
+        std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
         pdf_page *pdfPage{nullptr};
         fz_stext_page *stext_page{nullptr};
 
-        fz_try(m_ctx)
+        fz_try(ctx)
         {
-            pdfPage = pdf_load_page(m_ctx, m_pdf_doc, pageno);
+            pdfPage = pdf_load_page(ctx, m_pdf_doc, pageno);
             if (!pdfPage)
-                fz_throw(m_ctx, FZ_ERROR_GENERIC, "Failed to load page");
+                fz_throw(ctx, FZ_ERROR_GENERIC, "Failed to load page");
 
-            fz_page *page = fz_load_page(m_ctx, m_doc, pageno);
+            fz_page *page = fz_load_page(ctx, m_doc, pageno);
             if (page)
             {
-                stext_page = fz_new_stext_page_from_page(m_ctx, page, nullptr);
-                fz_drop_page(m_ctx, page);
+                stext_page = fz_new_stext_page_from_page(ctx, page, nullptr);
+                fz_drop_page(ctx, page);
             }
 
             if (!stext_page)
                 continue;
 
-            for (pdf_annot *annot = pdf_first_annot(m_ctx, pdfPage); annot;
-                 annot            = pdf_next_annot(m_ctx, annot))
+            for (pdf_annot *annot = pdf_first_annot(ctx, pdfPage); annot;
+                 annot            = pdf_next_annot(ctx, annot))
             {
-                if (pdf_annot_type(m_ctx, annot) != PDF_ANNOT_HIGHLIGHT)
+                if (pdf_annot_type(ctx, annot) != PDF_ANNOT_HIGHLIGHT)
                     continue;
 
-                const int quad_count = pdf_annot_quad_point_count(m_ctx, annot);
+                const int quad_count = pdf_annot_quad_point_count(ctx, annot);
                 if (quad_count <= 0)
                     continue;
 
                 std::vector<fz_quad> quads;
                 quads.reserve(quad_count);
                 for (int i = 0; i < quad_count; ++i)
-                    quads.push_back(pdf_annot_quad_point(m_ctx, annot, i));
+                    quads.push_back(pdf_annot_quad_point(ctx, annot, i));
 
                 std::vector<fz_quad> line_quads;
                 if (groupByLine)
@@ -2038,12 +2907,12 @@ Model::collectHighlightTexts(bool groupByLine) noexcept
                     const fz_point a{rect.x0, rect.y0};
                     const fz_point b{rect.x1, rect.y1};
                     char *selection_text
-                        = fz_copy_selection(m_ctx, stext_page, a, b, 0);
+                        = fz_copy_selection(ctx, stext_page, a, b, 0);
                     if (!selection_text)
                         continue;
 
                     QString text = QString::fromUtf8(selection_text).trimmed();
-                    fz_free(m_ctx, selection_text);
+                    fz_free(ctx, selection_text);
 
                     if (text.isEmpty())
                         continue;
@@ -2052,12 +2921,12 @@ Model::collectHighlightTexts(bool groupByLine) noexcept
                 }
             }
         }
-        fz_always(m_ctx)
+        fz_always(ctx)
         {
-            pdf_drop_page(m_ctx, pdfPage);
-            fz_drop_stext_page(m_ctx, stext_page);
+            pdf_drop_page(ctx, pdfPage);
+            fz_drop_stext_page(ctx, stext_page);
         }
-        fz_catch(m_ctx)
+        fz_catch(ctx)
         {
             qWarning() << "Failed to collect highlight text on page" << pageno;
         }
@@ -2066,52 +2935,218 @@ Model::collectHighlightTexts(bool groupByLine) noexcept
     return results;
 }
 
+TextCache::TextRef
+Model::pageText(int pageno, fz_document *doc) noexcept
+{
+    if (TextCache::TextRef text = m_text_cache.text(pageno))
+        return text;
+
+    TextCache::TextRef text;
+    TextCache::GeometryRef geometry;
+    extractPageText(pageno, doc, &text,
+                    m_text_cache.geometry(pageno) ? nullptr : &geometry);
+    return text;
+}
+
+TextCache::GeometryRef
+Model::pageTextGeometry(int pageno, fz_document *doc) noexcept
+{
+    if (TextCache::GeometryRef geometry = m_text_cache.geometry(pageno))
+        return geometry;
+
+    TextCache::GeometryRef geometry;
+    extractPageText(pageno, doc, nullptr, &geometry);
+    return geometry;
+}
+
+// Extracts the parts asked for and caches them. The shared document is only
+// locked while the page is loaded, the text page is converted after that.
 void
-Model::buildTextCacheForPage(int pageno) noexcept
+Model::extractPageText(int pageno, fz_document *doc, TextCache::TextRef *text,
+                       TextCache::GeometryRef *geometry) noexcept
 {
-    if (m_text_cache.contains(pageno))
+    // Workers must not share the GUI thread's m_ctx. Search workers already
+    // hold a lease, their private document is bound to it.
+    std::optional<FzContextPool::Lease> lease;
+    fz_context *ctx = FzContextPool::threadContext();
+    if (!ctx)
+    {
+        lease.emplace(m_ctx_pool);
+        ctx = lease->ctx();
+    }
+    if (!ctx)
         return;
 
+    const bool shared = !doc;
+    std::unique_lock<std::mutex> doc_lock(m_doc_mutex, std::defer_lock);
+    if (shared)
+    {
+        // Read under the lock, reloadDocument() replaces it
+        doc_lock.lock();
+        doc = m_doc;
+        if (!doc)
+            return;
+    }
+
+    fz_stext_page *stext = loadTextPage(ctx, doc, pageno);
+    if (shared)
+        doc_lock.unlock();
+    if (!stext)
+        return;
+
+    TextCache::Text page_text;
+    TextCache::Geometry page_geometry;
+    TextCache::extract(stext, text ? &page_text : nullptr,
+                       geometry ? &page_geometry : nullptr);
+    fz_drop_stext_page(ctx, stext);
+
+    // Another thread may have extracted the same page meanwhile, either
+    // copy is as good
+    if (geometry)
+        *geometry = m_text_cache.putGeometry(pageno, std::move(page_geometry));
+    if (text)
+        *text = m_text_cache.putText(pageno, std::move(page_text));
+    reportMemoryUsage();
+}
+
+// Null if the page cannot be loaded. The caller serializes access to doc.
+fz_stext_page *
+Model::loadTextPage(fz_context *ctx, fz_document *doc, int pageno) noexcept
+{
     fz_page *page        = nullptr;
     fz_stext_page *stext = nullptr;
 
-    fz_try(m_ctx)
+    fz_try(ctx)
     {
-        page  = fz_load_page(m_ctx, m_doc, pageno);
-        stext = fz_new_stext_page_from_page(m_ctx, page, nullptr);
-
-        CachedTextPage cache;
-        cache.chars.reserve(4096);
+        page  = fz_load_page(ctx, doc, pageno);
+        stext = fz_new_stext_page_from_page(ctx, page, nullptr);
+    }
+    fz_always(ctx)
+    {
+        fz_drop_page(ctx, page);
+    }
+    fz_catch(ctx)
+    {
+        // ignore page failures
+        stext = nullptr;
+    }
 
-        for (fz_stext_block *b = stext->first_block; b; b = b->next)
-        {
-            if (b->type != FZ_STEXT_BLOCK_TEXT)
-                continue;
+    return stext;
+}
 
-            for (fz_stext_line *l = b->u.t.first_line; l; l = l->next)
-            {
-                for (fz_stext_char *c = l->first_char; c; c = c->next)
-                {
-                    cache.chars.push_back(
-                        {static_cast<uint32_t>(c->c), c->quad});
-                }
+void
+Model::openTextIndex() noexcept
+{
+    closeTextIndex();
+
+    // The index holds the text of the file as it is on disk, so there is
+    // none for edited, encrypted or reflowable documents, whose text depends
+    // on the layout
+    if (!m_text_index_enabled || !m_doc || m_page_count < TEXT_INDEX_MIN_PAGES
+        || hasUnsavedChanges() || passwordRequired()
+        || fz_is_document_reflowable(m_ctx, m_doc))
+        return;
 
-                // logical line break (prevents cross-line matches)
-                cache.chars.push_back({'\n', {}});
-            }
-        }
+    const TextIndex::Key key = TextIndex::Key::of(m_filepath);
+    const QString path       = TextIndex::pathFor(key);
+    if (path.isEmpty())
+        return;
 
-        m_text_cache.emplace(pageno, std::move(cache));
-    }
-    fz_always(m_ctx)
+    // Mapping an index only reads its page table, so one saved before is
+    // there for a search started right after opening
+    std::shared_ptr<const TextIndex> saved
+        = TextIndex::open(path, key, m_page_count);
+    if (saved)
     {
-        fz_drop_stext_page(m_ctx, stext);
-        fz_drop_page(m_ctx, page);
+        std::lock_guard<std::mutex> lock(m_text_index_mutex);
+        m_text_index = std::move(saved);
+        return;
     }
-    fz_catch(m_ctx)
+
+    if (!m_text_index_build)
+        return;
+
+    const uint64_t generation = m_text_index_generation;
+
+    m_text_index_future = QtConcurrent::run([this, key, path, generation]()
     {
-        // ignore page failures
+        std::shared_ptr<const TextIndex> index
+            = buildTextIndex(key, path, generation);
+        if (!index)
+            return;
+
+#ifndef NDEBUG
+        qDebug() << "Text index ready:" << path;
+#endif
+        std::lock_guard<std::mutex> lock(m_text_index_mutex);
+        if (generation == m_text_index_generation)
+            m_text_index = std::move(index);
+    });
+}
+
+void
+Model::closeTextIndex() noexcept
+{
+    ++m_text_index_generation;
+    m_text_index_future.waitForFinished();
+
+    std::lock_guard<std::mutex> lock(m_text_index_mutex);
+    m_text_index.reset();
+}
+
+// Runs on a worker, one page after the other from a private copy of the
+// document. Pages the text cache holds already are not extracted again.
+std::shared_ptr<const TextIndex>
+Model::buildTextIndex(const TextIndex::Key &key, const QString &path,
+                      uint64_t generation) noexcept
+{
+    auto cancelled = [this, generation]()
+    { return generation != m_text_index_generation.load(); };
+
+    FzContextPool::Lease lease(m_ctx_pool);
+    fz_context *ctx = lease.ctx();
+    if (!ctx)
+        return nullptr;
+
+    fz_document *doc = openSearchDocument(ctx);
+    if (!doc)
+        return nullptr;
+
+    TextIndex::Builder builder(m_page_count);
+    for (int pageno = 0; pageno < m_page_count && !cancelled(); ++pageno)
+    {
+        const TextCache::TextRef text = m_text_cache.text(pageno);
+        const TextCache::GeometryRef geometry = m_text_cache.geometry(pageno);
+        if (text && geometry)
+        {
+            builder.addPage(*text, *geometry);
+            continue;
+        }
+
+        // Saved empty, the page would never be found again until the file
+        // changes. Left to extraction on every search instead.
+        fz_stext_page *stext = loadTextPage(ctx, doc, pageno);
+        if (!stext)
+        {
+            fz_drop_document(ctx, doc);
+            return nullptr;
+        }
+
+        TextCache::Text page_text;
+        TextCache::Geometry page_geometry;
+        TextCache::extract(stext, &page_text, &page_geometry);
+        fz_drop_stext_page(ctx, stext);
+        builder.addPage(page_text, page_geometry);
     }
+    fz_drop_document(ctx, doc);
+
+    // A file changed while it was read would be saved under the old key
+    const TextIndex::Key now = TextIndex::Key::of(key.path);
+    if (cancelled() || now.size != key.size || now.mtime != key.mtime
+        || !builder.write(path, key))
+        return nullptr;
+
+    return TextIndex::open(path, key, m_page_count);
 }
 
 // fz_pixmap *
@@ -2181,6 +3216,8 @@ Model::buildTextCacheForPage(int pageno) noexcept
 void
 Model::annotChangeColor(int pageno, int index, const QColor &color) noexcept
 {
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     if (!m_pdf_doc)
         return;
 
@@ -2249,25 +3286,9 @@ Model::getTextInArea(const int pageno, const QPointF &start,
 
     const float scale = m_zoom * (m_dpi / 72.0f);
 
-    fz_rect page_bounds{};
-    fz_page *page_for_bounds = nullptr;
-
-    fz_try(m_ctx)
-    {
-        page_for_bounds = fz_load_page(m_ctx, m_doc, pageno);
-        page_bounds     = fz_bound_page(m_ctx, page_for_bounds);
-    }
-    fz_always(m_ctx)
-    {
-        if (page_for_bounds)
-            fz_drop_page(m_ctx, page_for_bounds);
-    }
-    fz_catch(m_ctx)
-    {
-        qWarning() << "getTextInArea failed (bounds):"
-                   << fz_caught_message(m_ctx);
+    const fz_rect page_bounds = pageBounds(pageno);
+    if (fz_is_empty_rect(page_bounds))
         return result;
-    }
 
     fz_matrix page_to_dev    = fz_scale(scale, scale);
     page_to_dev              = fz_pre_rotate(page_to_dev, m_rotation);
@@ -2297,6 +3318,8 @@ Model::getTextInArea(const int pageno, const QPointF &start,
     fz_stext_page *stext_page{nullptr};
     char *selection_text{nullptr};
 
+    std::lock_guard<std::mutex> doc_lock(m_doc_mutex);
+
     fz_try(m_ctx)
     {
         page           = fz_load_page(m_ctx, m_doc, pageno);
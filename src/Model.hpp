@@ -4,15 +4,26 @@
 
 #include "Annotations/Annotation.hpp"
 #include "BrowseLinkItem.hpp"
+#include "FzContextPool.hpp"
 #include "LRUCache.hpp"
+#include "TextCache.hpp"
+#include "TextIndex.hpp"
+#include "SearchQuery.hpp"
 
 #include <QColor>
 #include <QFuture>
+#include <QHash>
 #include <QPixmap>
+#include <QRect>
 #include <QRectF>
 #include <QRegularExpression>
 #include <QString>
+#include <QThreadPool>
 #include <QUndoStack>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 
 extern "C"
@@ -65,6 +76,7 @@ public:
         int page;
         fz_quad quad; // Coordinate of the hit in logical page space
         int index;    // Index of the hit in the page
+        int length{0}; // Code units of the page text it spans
     };
 
     struct HighlightText
@@ -89,8 +101,51 @@ public:
         double dpi;
         double dpr;
         bool invert_color;
+        uint32_t fg_color;
+        uint32_t bg_color;
         fz_colorspace *colorspace;
         QString filepath; // path to PDF
+        // Pixels are produced at zoom * raster_scale, links and annotations
+        // always use the full zoom
+        double raster_scale{1.0};
+        // Part of the page to rasterize, in device pixels relative to the
+        // page's top-left corner. Empty renders the whole page, with links
+        // and annotations.
+        QRect tile;
+        // Quick low quality pass shown until the full render is done, without
+        // links and annotations
+        bool preview{false};
+        // Set abort on it to stop the job mid-render, its result is empty
+        std::shared_ptr<fz_cookie> cookie;
+    };
+
+    // Everything that changes the pixels of a rendered page
+    struct RenderCacheKey
+    {
+        int pageno;
+        double zoom;
+        int rotation;
+        double dpr;
+        bool invert_color;
+        uint32_t fg_color;
+        uint32_t bg_color;
+        double raster_scale;
+        QRect tile;
+        bool preview;
+
+        bool operator==(const RenderCacheKey &) const = default;
+    };
+
+    struct RenderCacheKeyHash
+    {
+        size_t operator()(const RenderCacheKey &key) const noexcept
+        {
+            return qHashMulti(0, key.pageno, key.zoom, key.rotation, key.dpr,
+                              key.invert_color, key.fg_color, key.bg_color,
+                              key.raster_scale, key.tile.x(), key.tile.y(),
+                              key.tile.width(), key.tile.height(),
+                              key.preview);
+        }
     };
 
     struct RenderLink
@@ -113,18 +168,25 @@ public:
         int index{-1};
     };
 
-    struct PageRenderResult
+    // Immutable once built and shared by every copy, so results travel
+    // through futures, callbacks and the render cache without deep copies
+    template <typename T>
+    using Snapshot = std::shared_ptr<const std::vector<T>>;
+
+    // Items of a snapshot, empty for a null one
+    template <typename T>
+    static inline const std::vector<T> &
+    snapshotItems(const Snapshot<T> &snapshot) noexcept
     {
-        QImage image;
-        std::vector<RenderLink> links;
-        std::vector<RenderAnnotation> annotations;
-    };
+        static const std::vector<T> empty;
+        return snapshot ? *snapshot : empty;
+    }
 
-    // structure to carry the "Life Support" for the image memory
-    struct RenderPayload
+    struct PageRenderResult
     {
-        fz_context *ctx;
-        fz_pixmap *pix;
+        QImage image;
+        Snapshot<RenderLink> links;             // null when there are none
+        Snapshot<RenderAnnotation> annotations; // null when there are none
     };
 
     inline void setRotation(float angle) noexcept
@@ -207,6 +269,12 @@ public:
         m_dpi = dpi;
     }
 
+    // Render workers apply it to their own context
+    inline void setAntialiasingBits(int bits) noexcept
+    {
+        m_aa_level = std::clamp(bits, 0, 8);
+    }
+
     inline float DPI() noexcept
     {
         return m_dpi;
@@ -261,16 +329,102 @@ public:
 
     inline void setCacheCapacity(const size_t n) noexcept
     {
+        std::lock_guard<std::recursive_mutex> lock(m_page_cache_mutex);
         m_page_lru_cache.setCapacity(n);
     }
 
+    // Memory budget for interpreted pages (display lists, links and
+    // annotations), 0 leaves only the page count limit
+    inline void setPageCacheBudget(const size_t bytes) noexcept
+    {
+        m_page_cache_budget = bytes;
+        applyCacheBudgets();
+    }
+
+    inline size_t pageCacheBytes() const noexcept
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_page_cache_mutex);
+        return m_page_lru_cache.weight();
+    }
+
+    // Memory budget for finished renders, 0 disables the render cache
+    inline void setRenderCacheBudget(const size_t bytes) noexcept
+    {
+        m_render_cache_budget = bytes;
+        applyCacheBudgets();
+    }
+
+    inline size_t renderCacheBytes() const noexcept
+    {
+        return m_render_cache.weight();
+    }
+
+    // Text extracted for searching
+    inline size_t textCacheBytes() const noexcept
+    {
+        return m_text_cache.bytes();
+    }
+
+    // Keep the text of documents with at least TEXT_INDEX_MIN_PAGES pages on
+    // disk, see TextIndex. Applies from the next opened document on.
+    inline void setTextIndexEnabled(const bool enabled) noexcept
+    {
+        m_text_index_enabled = enabled;
+    }
+
+    // A saved index is still used, but none is built for a Model that lives
+    // only for one search
+    inline void setTextIndexBuildEnabled(const bool enabled) noexcept
+    {
+        m_text_index_build = enabled;
+    }
+
+    // Share of the process-wide memory limit given by the MemoryGovernor,
+    // caps the configured cache budgets. 0 means no cap.
+    inline void setMemoryShare(const size_t bytes) noexcept
+    {
+        m_memory_share = bytes;
+        applyCacheBudgets();
+    }
+
+    // Memory held by MuPDF for this document (its store and display lists
+    // included) and by the render and text caches
+    size_t memoryUsage() const noexcept;
+    // Lets the MemoryGovernor enforce the limit after something was cached.
+    // Callable from any thread, reports from a burst of inserts are merged.
+    void reportMemoryUsage() noexcept;
+
+    // Drops every cache, used on background documents under memory pressure
+    void shedMemory() noexcept;
+
+    // Finished render matching job, if still cached. GUI thread only.
+    const PageRenderResult *cachedPageRender(const RenderJob &job) noexcept;
+
+    // Maximum number of pages rasterized at the same time
+    inline void setMaxConcurrentRenders(const int n) noexcept
+    {
+        m_render_pool.setMaxThreadCount(std::max(1, n));
+    }
+
+    inline int maxConcurrentRenders() const noexcept
+    {
+        return m_render_pool.maxThreadCount();
+    }
+
+    // Usage of the worker contexts, for tuning the render concurrency
+    inline FzContextPool::Stats contextPoolStats() const noexcept
+    {
+        return m_ctx_pool.stats();
+    }
+
     void setUrlLinkRegex(const QString &pattern) noexcept;
 
     // Clear page cache to free memory (e.g., when tab becomes inactive)
     void clearPageCache() noexcept;
 
-    // Ensure a page is cached (lazy loading)
-    void ensurePageCached(int pageno) noexcept;
+    // Ensure a page is cached (lazy loading), using the caller's context
+    void ensurePageCached(fz_context *ctx, int pageno,
+                          fz_cookie *cookie = nullptr) noexcept;
 
     inline void setBackgroundColor(const uint32_t bg) noexcept
     {
@@ -328,9 +482,11 @@ public:
     }
 
     RenderJob createRenderJob(int pageno) const noexcept;
+    static RenderCacheKey renderCacheKey(const RenderJob &job) noexcept;
+    bool isRenderJobCurrent(const RenderJob &job) const noexcept;
     void requestPageRender(
         const RenderJob &job,
-        const std::function<void(PageRenderResult)> &callback) noexcept;
+        const std::function<void(const PageRenderResult &)> &callback) noexcept;
     PageRenderResult renderPageWithExtrasAsync(const RenderJob &job) noexcept;
 
     // fz_pixmap *hitTestImage(int pageno, const QPointF &pt, float zoom,
@@ -339,6 +495,9 @@ public:
     std::vector<std::pair<QString, QString>> properties() noexcept;
     fz_outline *getOutline() noexcept;
     bool reloadDocument() noexcept;
+    // Closes the document and drops every cache but keeps the file path, so
+    // that reloadDocument() can bring it back
+    void suspend() noexcept;
     void openAsync(const QString &filePath,
                    const QString &password = {}) noexcept;
     void close() noexcept;
@@ -355,6 +514,9 @@ public:
     bool SaveAs(const QString &newFilePath) noexcept;
     QPointF toPixelSpace(int pageno, fz_point pt) const noexcept;
     fz_point toPDFSpace(int pageno, QPointF pt) const noexcept;
+    // Untransformed page rectangle, empty if the page cannot be loaded. Only
+    // the first call for a page loads it.
+    fz_rect pageBounds(int pageno) const noexcept;
     void cachePageDimension() noexcept;
 
     std::vector<QPolygonF>
@@ -369,9 +531,48 @@ public:
     void highlightTextSelection(int pageno, const QPointF &start,
                                 const QPointF &end) noexcept;
     void invalidatePageCache(int pageno) noexcept;
-    void search(const QString &term, bool caseSensitive = false) noexcept;
-    std::vector<Model::SearchHit> searchHelper(int pageno, const QString &term,
-                                               bool caseSensitive) noexcept;
+    // Pages nearest to startPage are searched first, hits arrive in
+    // batches through searchResultsReady() and searchFinished() follows the
+    // last one, or searchFailed() if the term is not a valid regular
+    // expression
+    void search(const QString &term, const SearchQuery::Options &options = {},
+                int startPage = 0) noexcept;
+    // Stops the running search after its current page, nothing more is
+    // emitted for it. Starting a new search does this too.
+    void cancelSearch() noexcept;
+    // Searches the whole document for someone other than the view, without
+    // touching search(). Batches of hits go to onResults and the match count
+    // to onFinished, both on the GUI thread; a document that cannot be
+    // searched finishes with 0 at once.
+    void searchDocument(
+        std::shared_ptr<const SearchQuery> query,
+        std::function<void(const QMap<int, std::vector<SearchHit>> &)>
+            onResults,
+        std::function<void(int)> onFinished) noexcept;
+    // Nothing more reaches the callbacks of the running searchDocument()
+    void cancelDocumentSearch() noexcept;
+    inline bool isDocumentSearchRunning() const noexcept
+    {
+        return m_document_search_future.isRunning();
+    }
+    // Text around a hit, taken from the page text already cached or saved
+    // and empty rather than extracted. GUI thread.
+    QString searchHitContext(const SearchHit &hit, int radius = 40) noexcept;
+    // A search worker's private copy of the document, see
+    // openSearchDocument(). Only opened once a page's text is not cached; if
+    // that fails the worker keeps using the shared document.
+    struct PrivateDocument
+    {
+        fz_context *ctx{nullptr};
+        fz_document *doc{nullptr};
+        bool opened{false}; // tried, doc stays null if it failed
+    };
+
+    // Null doc searches the shared document
+    std::vector<Model::SearchHit> searchHelper(int pageno,
+                                               const SearchQuery &query,
+                                               PrivateDocument *doc
+                                               = nullptr) noexcept;
     std::vector<HighlightText> collectHighlightTexts(bool groupByLine
                                                      = true) noexcept;
     void annotChangeColor(int pageno, int index, const QColor &color) noexcept;
@@ -382,13 +583,21 @@ signals:
     void reloadRequested(int pageno);
     void
     searchResultsReady(const QMap<int, std::vector<Model::SearchHit>> &results);
+    void searchFinished(int matchCount);
+    void searchFailed(const QString &error);
 
 private:
     inline void waitForRenders() noexcept
     {
-        if (m_render_future.isRunning())
-            m_render_future.waitForFinished();
+        m_render_pool.waitForDone();
     }
+    // Remembers a search for waitForSearches(), forgetting finished ones
+    void trackSearch(const QFuture<void> &future) noexcept;
+    // Every search, not only the newest: a superseded one stops at its next
+    // page and may still be extracting one
+    void waitForSearches() noexcept;
+    // cancelDocumentSearch(), but the search still reports it finished
+    void interruptDocumentSearch() noexcept;
 
     inline FileType fileType() const noexcept
     {
@@ -425,19 +634,10 @@ private:
         fz_display_list *display_list{nullptr};
         fz_rect bounds{};
 
-        std::vector<CachedLink> links;
-        std::vector<CachedAnnotation> annotations;
-    };
-
-    struct CachedTextChar
-    {
-        uint32_t rune;
-        fz_quad quad;
-    };
-
-    struct CachedTextPage
-    {
-        std::vector<CachedTextChar> chars;
+        // Shared with the render workers, which take a reference under the
+        // cache lock instead of copying
+        Snapshot<CachedLink> links;
+        Snapshot<CachedAnnotation> annotations;
     };
 
     // Used for hit-testing images on a page
@@ -475,7 +675,8 @@ private:
         m_inv_dpr{1.0f};
     bool m_invert_color{false};
 
-    void buildPageCache(int pageno) noexcept;
+    void buildPageCache(fz_context *ctx, int pageno,
+                        fz_cookie *cookie = nullptr) noexcept;
     int addRectAnnotation(const int pageno, const fz_rect &rect) noexcept;
     int addHighlightAnnotation(const int pageno,
                                const std::vector<fz_quad> &quads) noexcept;
@@ -485,8 +686,63 @@ private:
                                    const QString &text) noexcept;
     void removeAnnotations(const int pageno,
                            const std::vector<int> &objNums) noexcept;
-    void buildTextCacheForPage(int pageno) noexcept;
+    // Text of a page for searching, extracted on first use along with its
+    // geometry, which comes for free then. Any thread; doc is a private copy
+    // from openSearchDocument(), null uses the shared document.
+    TextCache::TextRef pageText(int pageno,
+                                fz_document *doc = nullptr) noexcept;
+    // Extracted again if it was evicted since
+    TextCache::GeometryRef pageTextGeometry(int pageno,
+                                            fz_document *doc
+                                            = nullptr) noexcept;
+    void extractPageText(int pageno, fz_document *doc,
+                         TextCache::TextRef *text,
+                         TextCache::GeometryRef *geometry) noexcept;
+    static fz_stext_page *loadTextPage(fz_context *ctx, fz_document *doc,
+                                       int pageno) noexcept;
+    // searchHelper() over the saved text of the page instead
+    std::vector<SearchHit>
+    searchIndexedPage(int pageno, const TextIndex &index,
+                      const TextIndex::Trigrams &trigrams,
+                      const SearchQuery &query) noexcept;
+    static std::vector<SearchHit>
+    placeSearchHits(int pageno, const std::vector<SearchQuery::Match> &matches,
+                    const TextCache::Geometry &geometry) noexcept;
+    // Maps the saved text of the open document, building it first in the
+    // background if there is none. GUI thread.
+    void openTextIndex() noexcept;
+    // Stops a build and unmaps the index
+    void closeTextIndex() noexcept;
+    std::shared_ptr<const TextIndex>
+    buildTextIndex(const TextIndex::Key &key, const QString &path,
+                   uint64_t generation) noexcept;
+    inline std::shared_ptr<const TextIndex> textIndex() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_text_index_mutex);
+        return m_text_index;
+    }
+    fz_document *openSearchDocument(fz_context *ctx) const noexcept;
+    // Opens doc on first use, null means the shared document
+    fz_document *privateDocument(PrivateDocument *doc) const noexcept;
+    // Whether search workers get private copies of the document, see
+    // openSearchDocument(). GUI thread.
+    bool canSearchPrivately() const noexcept;
+    // Body of search() and searchDocument(), run on the calling thread with
+    // helpers from searchPool(). Batches of hits go to deliver from
+    // whichever thread found them, one at a time. Returns the match count.
+    int runSearch(const SearchQuery &query, int pageCount, bool private_docs,
+                  const std::shared_ptr<const TextIndex> &index, int startPage,
+                  const std::function<bool()> &cancelled,
+                  const std::function<void(QMap<int, std::vector<SearchHit>>
+                                               &&)> &deliver) noexcept;
+    // Shared by all documents, searching many at once starts no more
+    // workers than there are cores
+    static QThreadPool &searchPool() noexcept;
     void LRUEvictFunction(PageCacheEntry &entry) noexcept;
+    static size_t pageCacheEntryBytes(fz_context *ctx,
+                                      const PageCacheEntry &entry) noexcept;
+    void applyCacheBudgets() noexcept;
+    void shrinkStoreToShare() noexcept;
 
     void populatePDFProperties(
         std::vector<std::pair<QString, QString>> &props) noexcept;
@@ -509,17 +765,67 @@ private:
     float m_page_width_pts{0.0f}, m_page_height_pts{0.0f};
     fz_point m_selection_start{}, m_selection_end{};
     fz_locks_context m_fz_locks;
+    fz_alloc_context m_fz_alloc;
+    std::atomic<size_t> m_fz_bytes{0}; // live MuPDF allocations
     mutable std::recursive_mutex m_page_cache_mutex;
+    // Weighted by the estimated size of each entry in bytes
     LRUCache<int, PageCacheEntry> m_page_lru_cache;
+    uint64_t m_page_cache_generation{0}; // guarded by m_page_cache_mutex
+    // Page rectangles, guarded by m_page_cache_mutex. Kept when page cache
+    // entries are evicted, so coordinate math on the GUI thread does not wait
+    // for the document.
+    mutable std::unordered_map<int, fz_rect> m_page_bounds;
+
+    // Rendered pages, weighted by their size in bytes. Only touched from the
+    // GUI thread.
+    static constexpr size_t RENDER_CACHE_MAX_ENTRIES = 4096;
+    static constexpr int PREVIEW_AA_BITS            = 2;
+    std::atomic<int> m_aa_level{8};
+    LRUCache<RenderCacheKey, PageRenderResult, RenderCacheKeyHash>
+        m_render_cache;
+    uint64_t m_render_cache_generation{0};
+
+    // Configured cache budgets and the governor's cap on their sum
+    size_t m_page_cache_budget{0};
+    size_t m_render_cache_budget{0};
+    size_t m_memory_share{0};
+    std::atomic<bool> m_usage_report_pending{false};
 
     uint32_t m_bg_color{0};
     uint32_t m_fg_color{0};
 
-    std::mutex m_doc_mutex;
-    QFuture<PageRenderResult> m_render_future;
+    // fz_document is not thread-safe: held by whoever loads pages from it
+    mutable std::mutex m_doc_mutex;
+    QThreadPool m_render_pool;
+    // Search workers, each claims SEARCH_CHUNK_PAGES pages at a time
+    static constexpr int SEARCH_CHUNK_PAGES = 8;
+    // Batches of hits are at least this far apart, except for the first
+    static constexpr qint64 SEARCH_BATCH_MS = 50;
+    // Render workers borrow their fz_context from here
+    FzContextPool m_ctx_pool;
     pdf_write_options m_pdf_write_options{pdf_default_write_options};
     int m_search_match_count{0};
-    std::unordered_map<int, CachedTextPage> m_text_cache;
+    // Bumped by every search and cancelSearch(), workers of an older one
+    // stop and its batches are dropped on arrival
+    std::atomic<uint64_t> m_search_generation{0};
+    TextCache m_text_cache;
+    // Searches that may still be running, superseded ones included. GUI
+    // thread.
+    std::vector<QFuture<void>> m_search_futures;
+    // As m_search_generation, for searchDocument()
+    std::atomic<uint64_t> m_document_search_generation{0};
+    QFuture<void> m_document_search_future;
+    // onFinished of the running one, until it is called
+    std::function<void(int)> m_document_search_finished;
+    // Smaller documents are extracted quickly enough on every search
+    static constexpr int TEXT_INDEX_MIN_PAGES = 50;
+    bool m_text_index_enabled{true};
+    bool m_text_index_build{true};
+    std::shared_ptr<const TextIndex> m_text_index; // m_text_index_mutex
+    mutable std::mutex m_text_index_mutex;
+    QFuture<void> m_text_index_future;
+    // Bumped by closeTextIndex(), a build of an older one stops
+    std::atomic<uint64_t> m_text_index_generation{0};
     bool m_link_show_boundary{false};
     bool m_detect_url_links{false};
     QRegularExpression m_url_link_re;
@@ -0,0 +1,262 @@
+#include "PixelTransform.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__))                                \
+    && (defined(__GNUC__) || defined(__clang__))
+#define PIXEL_TRANSFORM_X86 1
+#include <immintrin.h>
+#endif
+
+// All kernels use the same integer math so that the result does not depend
+// on the CPU:
+//   tint:   c = (c * white + (255 - c) * black) / 255, rounded
+//   invert: y = (77 r + 150 g + 29 b + 128) >> 8, c = clamp(c + 255 - 2 y)
+//   gamma:  lookup table
+struct PixelTransform::Kernel
+{
+    using Fn = void (*)(const PixelTransform &, unsigned char *, size_t);
+
+    static inline unsigned div255(unsigned x) noexcept
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    static void scalar(const PixelTransform &t, unsigned char *p,
+                       size_t pixels) noexcept
+    {
+        for (size_t i = 0; i < pixels; ++i, p += 4)
+        {
+            if (t.m_tint)
+            {
+                for (int c = 0; c < 3; ++c)
+                    p[c] = div255(p[c] * t.m_white[c]
+                                  + (255 - p[c]) * t.m_black[c]);
+            }
+
+            if (t.m_invert)
+            {
+                const int y = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+                const int d = 255 - 2 * y;
+                for (int c = 0; c < 3; ++c)
+                    p[c] = std::clamp(p[c] + d, 0, 255);
+            }
+
+            if (t.m_gamma)
+            {
+                for (int c = 0; c < 3; ++c)
+                    p[c] = t.m_gamma_lut[p[c]];
+            }
+        }
+    }
+
+#ifdef PIXEL_TRANSFORM_X86
+    // Pixels are widened to 16 bit lanes and processed interleaved, two per
+    // 128 bit lane. Alpha goes through the tint as white 255 / black 0, which
+    // leaves it as is. The constants are hoisted out of the loops once this
+    // is inlined.
+    __attribute__((target("sse4.1"))) static inline __m128i
+    process(const PixelTransform &t, __m128i v) noexcept
+    {
+        if (t.m_tint)
+        {
+            const __m128i white
+                = _mm_setr_epi16(t.m_white[0], t.m_white[1], t.m_white[2], 255,
+                                 t.m_white[0], t.m_white[1], t.m_white[2], 255);
+            const __m128i black
+                = _mm_setr_epi16(t.m_black[0], t.m_black[1], t.m_black[2], 0,
+                                 t.m_black[0], t.m_black[1], t.m_black[2], 0);
+            __m128i x = _mm_add_epi16(
+                _mm_mullo_epi16(v, white),
+                _mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), v), black));
+            x = _mm_add_epi16(x, _mm_set1_epi16(128));
+            v = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        }
+
+        if (t.m_invert)
+        {
+            const __m128i luma
+                = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+            const __m128i rgb = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+            // Low 16 bits of the per pixel 32 bit delta, copied to each channel
+            const __m128i spread
+                = _mm_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 8, 9, 8, 9, 8, 9, 8, 9);
+
+            __m128i y = _mm_madd_epi16(v, luma);
+            y = _mm_add_epi32(y, _mm_shuffle_epi32(y, 0xB1));
+            y = _mm_srli_epi32(_mm_add_epi32(y, _mm_set1_epi32(128)), 8);
+            __m128i d
+                = _mm_sub_epi32(_mm_set1_epi32(255), _mm_add_epi32(y, y));
+            d = _mm_and_si128(_mm_shuffle_epi8(d, spread), rgb);
+            v = _mm_add_epi16(v, d);
+        }
+        return v;
+    }
+
+    // Same as above on two independent 128 bit lanes
+    __attribute__((target("avx2"))) static inline __m256i
+    process(const PixelTransform &t, __m256i v) noexcept
+    {
+        if (t.m_tint)
+        {
+            const __m256i white = _mm256_setr_epi16(
+                t.m_white[0], t.m_white[1], t.m_white[2], 255, t.m_white[0],
+                t.m_white[1], t.m_white[2], 255, t.m_white[0], t.m_white[1],
+                t.m_white[2], 255, t.m_white[0], t.m_white[1], t.m_white[2],
+                255);
+            const __m256i black = _mm256_setr_epi16(
+                t.m_black[0], t.m_black[1], t.m_black[2], 0, t.m_black[0],
+                t.m_black[1], t.m_black[2], 0, t.m_black[0], t.m_black[1],
+                t.m_black[2], 0, t.m_black[0], t.m_black[1], t.m_black[2], 0);
+            __m256i x = _mm256_add_epi16(
+                _mm256_mullo_epi16(v, white),
+                _mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(255), v),
+                                   black));
+            x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+            v = _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)),
+                                  8);
+        }
+
+        if (t.m_invert)
+        {
+            const __m256i luma = _mm256_setr_epi16(
+                77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0);
+            const __m256i rgb = _mm256_setr_epi16(
+                -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+            const __m256i spread = _mm256_setr_epi8(
+                0, 1, 0, 1, 0, 1, 0, 1, 8, 9, 8, 9, 8, 9, 8, 9, 0, 1, 0, 1, 0,
+                1, 0, 1, 8, 9, 8, 9, 8, 9, 8, 9);
+
+            __m256i y = _mm256_madd_epi16(v, luma);
+            y = _mm256_add_epi32(y, _mm256_shuffle_epi32(y, 0xB1));
+            y = _mm256_srli_epi32(_mm256_add_epi32(y, _mm256_set1_epi32(128)),
+                                  8);
+            __m256i d = _mm256_sub_epi32(_mm256_set1_epi32(255),
+                                         _mm256_add_epi32(y, y));
+            d = _mm256_and_si256(_mm256_shuffle_epi8(d, spread), rgb);
+            v = _mm256_add_epi16(v, d);
+        }
+        return v;
+    }
+
+    __attribute__((target("sse4.1"))) static void
+    sse41(const PixelTransform &t, unsigned char *p, size_t pixels) noexcept
+    {
+        const size_t vector_pixels = pixels & ~size_t{3};
+        for (size_t i = 0; i < vector_pixels; i += 4, p += 16)
+        {
+            const __m128i x
+                = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const __m128i lo = process(t, _mm_cvtepu8_epi16(x));
+            const __m128i hi
+                = process(t, _mm_unpackhi_epi8(x, _mm_setzero_si128()));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+                             _mm_packus_epi16(lo, hi));
+
+            if (t.m_gamma)
+                applyGamma(t, p, 4);
+        }
+
+        scalar(t, p, pixels - vector_pixels);
+    }
+
+    __attribute__((target("avx2"))) static void
+    avx2(const PixelTransform &t, unsigned char *p, size_t pixels) noexcept
+    {
+        const __m256i zero         = _mm256_setzero_si256();
+        const size_t vector_pixels = pixels & ~size_t{7};
+        for (size_t i = 0; i < vector_pixels; i += 8, p += 32)
+        {
+            const __m256i x
+                = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            // Unpacking and packing both stay within 128 bit lanes, so the
+            // pixel order is restored
+            const __m256i lo = process(t, _mm256_unpacklo_epi8(x, zero));
+            const __m256i hi = process(t, _mm256_unpackhi_epi8(x, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(p),
+                                _mm256_packus_epi16(lo, hi));
+
+            if (t.m_gamma)
+                applyGamma(t, p, 8);
+        }
+
+        scalar(t, p, pixels - vector_pixels);
+    }
+
+    // Applied right after the vector part, while the pixels are in L1
+    static inline void applyGamma(const PixelTransform &t, unsigned char *p,
+                             size_t pixels) noexcept
+    {
+        for (size_t i = 0; i < pixels; ++i, p += 4)
+        {
+            p[0] = t.m_gamma_lut[p[0]];
+            p[1] = t.m_gamma_lut[p[1]];
+            p[2] = t.m_gamma_lut[p[2]];
+        }
+    }
+#endif
+
+    struct Selected
+    {
+        Fn fn;
+        const char *name;
+    };
+
+    static Selected select() noexcept
+    {
+#ifdef PIXEL_TRANSFORM_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return {avx2, "avx2"};
+        if (__builtin_cpu_supports("sse4.1"))
+            return {sse41, "sse4.1"};
+#endif
+        return {scalar, "scalar"};
+    }
+
+    static const Selected &selected() noexcept
+    {
+        static const Selected kernel = select();
+        return kernel;
+    }
+};
+
+PixelTransform::PixelTransform(uint32_t black, uint32_t white, bool invert,
+                               float gamma) noexcept
+    : m_invert(invert)
+{
+    for (int c = 0; c < 3; ++c)
+    {
+        const int shift = 16 - 8 * c;
+        m_black[c]      = (black >> shift) & 0xFF;
+        m_white[c]      = (white >> shift) & 0xFF;
+    }
+    m_black[3] = 0;
+    m_white[3] = 255;
+    m_tint     = (black & 0xFFFFFF) != 0 || (white & 0xFFFFFF) != 0xFFFFFF;
+
+    m_gamma = gamma > 0.0f && gamma != 1.0f;
+    if (m_gamma)
+    {
+        for (int i = 0; i < 256; ++i)
+            m_gamma_lut[i] = static_cast<uint8_t>(
+                std::lround(std::pow(i / 255.0, gamma) * 255.0));
+    }
+}
+
+void
+PixelTransform::apply(unsigned char *rgba, size_t pixels) const noexcept
+{
+    if (!rgba || isIdentity())
+        return;
+
+    Kernel::selected().fn(*this, rgba, pixels);
+}
+
+const char *
+PixelTransform::kernelName() noexcept
+{
+    return Kernel::selected().name;
+}
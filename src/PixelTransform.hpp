@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Post-processing applied to rendered RGBA8888 pages in a single pass: tint
+// (black maps to the foreground color, white to the background color),
+// luminance inversion and gamma. The widest instruction set supported by the
+// CPU is picked at runtime; every path gives the same bytes.
+class PixelTransform
+{
+public:
+    // Colors are 0xRRGGBB
+    PixelTransform(uint32_t black, uint32_t white, bool invert,
+                   float gamma) noexcept;
+
+    inline bool isIdentity() const noexcept
+    {
+        return !m_tint && !m_invert && !m_gamma;
+    }
+
+    // Alpha is left untouched
+    void apply(unsigned char *rgba, size_t pixels) const noexcept;
+
+    // Name of the kernel apply() dispatches to, for diagnostics
+    static const char *kernelName() noexcept;
+
+    struct Kernel;
+
+private:
+    std::array<uint8_t, 4> m_black{}; // per channel value for 0
+    std::array<uint8_t, 4> m_white{}; // per channel value for 255
+    bool m_tint{false};
+    bool m_invert{false};
+    bool m_gamma{false};
+    std::array<uint8_t, 256> m_gamma_lut{};
+};
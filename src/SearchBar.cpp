@@ -18,12 +18,31 @@ SearchBar::SearchBar(QWidget *parent) : QWidget(parent)
     m_closeButton      = new QPushButton(this);
     m_searchCountLabel = new QLabel(this);
     m_searchIndexLabel = new QLineEdit(this);
+    m_regexButton      = new QPushButton(".*", this);
+    m_wholeWordButton  = new QPushButton("W", this);
+    m_diacriticsButton = new QPushButton("\u00E4", this);
 
     m_searchInput->setFocusPolicy(Qt::ClickFocus);
 
     m_nextButton->setToolTip("Goto Next Hit");
     m_prevButton->setToolTip("Goto Previous Hit");
     m_closeButton->setToolTip("Close Search Bar");
+    m_regexButton->setToolTip("Regular Expression");
+    m_wholeWordButton->setToolTip("Whole Words Only");
+    m_diacriticsButton->setToolTip("Ignore Accents");
+
+    for (QPushButton *button :
+         {m_regexButton, m_wholeWordButton, m_diacriticsButton})
+    {
+        button->setCheckable(true);
+        button->setFocusPolicy(Qt::NoFocus);
+        // Redo the search in the new mode
+        connect(button, &QPushButton::toggled, this, [this]()
+        {
+            if (!m_searchInput->text().isEmpty())
+                search(m_searchInput->text());
+        });
+    }
 
     m_nextButton->setIcon(style()->standardIcon(QStyle::SP_ArrowForward));
     m_prevButton->setIcon(style()->standardIcon(QStyle::SP_ArrowBack));
@@ -33,6 +52,9 @@ SearchBar::SearchBar(QWidget *parent) : QWidget(parent)
     layout->addWidget(m_spinner);
     layout->addWidget(m_label);
     layout->addWidget(m_searchInput, 1);
+    layout->addWidget(m_regexButton);
+    layout->addWidget(m_wholeWordButton);
+    layout->addWidget(m_diacriticsButton);
     layout->addWidget(m_searchIndexLabel);
     layout->addWidget(m_searchSeparator);
     layout->addWidget(m_searchCountLabel);
@@ -125,3 +147,13 @@ SearchBar::search(const QString &term) noexcept
     if (term.isEmpty())
         this->hide();
 }
+
+SearchQuery::Options
+SearchBar::options() const noexcept
+{
+    SearchQuery::Options options;
+    options.regex             = m_regexButton->isChecked();
+    options.whole_word        = m_wholeWordButton->isChecked();
+    options.ignore_diacritics = m_diacriticsButton->isChecked();
+    return options;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "SearchQuery.hpp"
 #include "WaitingSpinnerWidget.hpp"
 
 #include <QKeyEvent>
@@ -17,6 +18,8 @@ public:
     void setSearchCount(int count) noexcept;
     void setSearchIndex(int index) noexcept;
     void search(const QString &term) noexcept;
+    // Modes toggled in the bar, case sensitivity is left to the caller
+    SearchQuery::Options options() const noexcept;
 
     inline void focusSearchInput() noexcept
     {
@@ -47,6 +50,9 @@ private:
     QPushButton *m_prevButton;
     QPushButton *m_nextButton;
     QPushButton *m_closeButton;
+    QPushButton *m_regexButton;
+    QPushButton *m_wholeWordButton;
+    QPushButton *m_diacriticsButton;
     WaitingSpinnerWidget *m_spinner;
 
 protected:
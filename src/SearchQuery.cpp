@@ -0,0 +1,240 @@
+#include "SearchQuery.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+
+namespace
+{
+// Replaces every code unit by its base letter and drops combining marks.
+// map gets the position in text of every unit of out, it is left empty if
+// nothing was dropped and positions are the same.
+void
+stripDiacritics(std::u16string_view text, std::u16string &out,
+                std::vector<uint32_t> &map)
+{
+    out.clear();
+    out.reserve(text.size());
+    bool dropped = false;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        const char16_t c = SearchQuery::stripDiacritic(text[i]);
+        if (c == SearchQuery::DROP)
+        {
+            if (!dropped)
+            {
+                dropped = true;
+                map.resize(out.size());
+                std::iota(map.begin(), map.end(), 0u);
+            }
+            continue;
+        }
+
+        if (dropped)
+            map.push_back(static_cast<uint32_t>(i));
+        out.push_back(c);
+    }
+}
+
+bool
+isWordChar(std::u16string_view text, size_t i) noexcept
+{
+    if (i >= text.size())
+        return false;
+
+    const QChar c(text[i]);
+    return c.isLetterOrNumber() || c.isMark() || c == u'_';
+}
+} // namespace
+
+SearchQuery::SearchQuery(const QString &term, const Options &options)
+    : m_options(options), m_empty(term.isEmpty())
+{
+    if (m_empty)
+        return;
+
+    const std::u16string_view needle(
+        reinterpret_cast<const char16_t *>(term.utf16()), term.size());
+
+    std::u16string pattern = options.case_sensitive || options.regex
+                                 ? std::u16string(needle)
+                                 : TextMatcher::fold(needle);
+    if (options.ignore_diacritics)
+    {
+        std::u16string stripped;
+        std::vector<uint32_t> map;
+        stripDiacritics(pattern, stripped, map);
+        pattern = std::move(stripped);
+    }
+
+    if (options.regex)
+    {
+        QRegularExpression::PatternOptions flags
+            = QRegularExpression::UseUnicodePropertiesOption;
+        if (!options.case_sensitive)
+            flags |= QRegularExpression::CaseInsensitiveOption;
+
+        m_regex.emplace(QString::fromUtf16(pattern.data(), pattern.size()),
+                        flags);
+        if (!m_regex->isValid())
+        {
+            m_error = m_regex->errorString();
+            m_regex.reset();
+            return;
+        }
+
+        // Compiled here, so that the search workers only match
+        m_regex->optimize();
+        return;
+    }
+
+    // A term made of combining marks only has nothing left to look for
+    if (pattern.empty())
+    {
+        m_empty = true;
+        return;
+    }
+
+    if (!options.ignore_diacritics)
+        m_required = TextMatcher::fold(needle);
+    m_matcher.emplace(pattern);
+}
+
+void
+SearchQuery::findAll(std::u16string_view chars, std::u16string_view folded,
+                     std::vector<Match> &out) const
+{
+    if (m_empty || !isValid())
+        return;
+
+    // Regular expressions fold case themselves
+    std::u16string_view text
+        = m_options.case_sensitive || m_regex ? chars : folded;
+
+    std::u16string stripped;
+    std::vector<uint32_t> map;
+    if (m_options.ignore_diacritics)
+    {
+        stripDiacritics(text, stripped, map);
+        text = stripped;
+    }
+
+    const size_t first = out.size();
+    if (m_regex)
+    {
+        // Matched in place, the page text is not copied
+        const QString subject
+            = QString::fromRawData(reinterpret_cast<const QChar *>(text.data()),
+                                   static_cast<qsizetype>(text.size()));
+        QRegularExpressionMatchIterator it = m_regex->globalMatch(subject);
+        while (it.hasNext())
+        {
+            const QRegularExpressionMatch match = it.next();
+            // Empty matches have nothing to highlight
+            if (match.capturedLength() > 0)
+                out.push_back({static_cast<uint32_t>(match.capturedStart()),
+                               static_cast<uint32_t>(match.capturedLength())});
+        }
+    }
+    else
+    {
+        std::vector<uint32_t> positions;
+        m_matcher->findAll(text, positions);
+        out.reserve(first + positions.size());
+        for (const uint32_t p : positions)
+            out.push_back({p, static_cast<uint32_t>(m_matcher->size())});
+    }
+
+    // Back to positions in chars, spanning the dropped marks in between
+    if (!map.empty())
+    {
+        for (size_t i = first; i < out.size(); ++i)
+        {
+            Match &m           = out[i];
+            const uint32_t end = map[m.start + m.length - 1] + 1;
+            m.start            = map[m.start];
+            m.length           = end - m.start;
+        }
+    }
+
+    if (m_options.whole_word)
+    {
+        out.erase(std::remove_if(out.begin() + first, out.end(),
+                                 [chars](const Match &m)
+        {
+            return (m.start > 0 && isWordChar(chars, m.start - 1))
+                   || isWordChar(chars, m.start + m.length);
+        }), out.end());
+    }
+}
+
+bool
+SearchQuery::isSmartCaseSensitive(const QString &term, bool regex) noexcept
+{
+    for (qsizetype i = 0; i < term.size(); ++i)
+    {
+        if (regex && term[i] == u'\\' && i + 1 < term.size())
+        {
+            // The escaped letter, with its braced argument as in \p{Lu} and
+            // \x{00C9}, or the two hex digits of \xC9
+            const QChar c = term[++i];
+            if (i + 1 < term.size() && term[i + 1] == u'{')
+            {
+                const qsizetype close = term.indexOf(u'}', i + 2);
+                i                     = close < 0 ? term.size() : close;
+            }
+            else if (c == u'x')
+            {
+                for (int n = 0; n < 2 && i + 1 < term.size(); ++n, ++i)
+                {
+                    const char h = term[i + 1].toLatin1();
+                    if (!std::isxdigit(static_cast<unsigned char>(h)))
+                        break;
+                }
+            }
+            continue;
+        }
+
+        if (term[i].isUpper())
+            return true;
+    }
+    return false;
+}
+
+char16_t
+SearchQuery::stripDiacritic(char16_t c) noexcept
+{
+    static const std::vector<char16_t> table = []()
+    {
+        std::vector<char16_t> t(0x10000);
+        for (uint32_t u = 0; u < t.size(); ++u)
+        {
+            char16_t base = static_cast<char16_t>(u);
+            if (QChar(base).isSurrogate())
+            {
+                t[u] = base;
+                continue;
+            }
+
+            if (QChar(base).category() == QChar::Mark_NonSpacing)
+            {
+                t[u] = DROP;
+                continue;
+            }
+
+            // Canonical decompositions lead to the base letter in steps,
+            // "ǘ" to "ü" to "u"
+            while (QChar(base).decompositionTag() == QChar::Canonical)
+            {
+                const QString d = QChar(base).decomposition();
+                if (d.isEmpty() || d.at(0).isSurrogate())
+                    break;
+                base = d.at(0).unicode();
+            }
+            t[u] = base;
+        }
+        return t;
+    }();
+
+    return table[c];
+}
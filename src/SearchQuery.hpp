@@ -0,0 +1,82 @@
+#pragma once
+
+#include "TextMatcher.hpp"
+
+#include <QRegularExpression>
+#include <QString>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A search term compiled once for all pages of a search. Plain terms go to a
+// TextMatcher, regular expressions to a JIT compiled QRegularExpression; both
+// run over the UTF-16 page text of TextCache or TextIndex and yield spans of
+// it, so nothing per character is built for pages without hits. Safe to use
+// from several threads at once.
+class SearchQuery
+{
+public:
+    struct Options
+    {
+        bool case_sensitive{false};
+        bool whole_word{false};
+        bool regex{false};
+        bool ignore_diacritics{false}; // "e" also finds "é", "è" and "ê"
+    };
+
+    struct Match
+    {
+        uint32_t start;
+        uint32_t length;
+    };
+
+    SearchQuery(const QString &term, const Options &options);
+
+    // False for a malformed regular expression
+    inline bool isValid() const noexcept
+    {
+        return m_error.isEmpty();
+    }
+
+    inline const QString &errorString() const noexcept
+    {
+        return m_error;
+    }
+
+    inline bool isEmpty() const noexcept
+    {
+        return m_empty;
+    }
+
+    // Appends the spans matching in a page, in order. folded is chars after
+    // TextMatcher::fold().
+    void findAll(std::u16string_view chars, std::u16string_view folded,
+                 std::vector<Match> &out) const;
+
+    // Case-folded text every match contains, for TextIndex::trigrams().
+    // Empty if there is none, regular expressions and diacritics are not
+    // looked into.
+    inline const std::u16string &requiredText() const noexcept
+    {
+        return m_required;
+    }
+
+    // Smart case: a term with an upper case letter is searched case
+    // sensitively. Escapes of a regular expression, \W or \p{Lu}, do not
+    // count.
+    static bool isSmartCaseSensitive(const QString &term, bool regex) noexcept;
+
+    // Base letter of a code unit, DROP for combining marks
+    static char16_t stripDiacritic(char16_t c) noexcept;
+    static constexpr char16_t DROP = 0xFFFF;
+
+private:
+    Options m_options;
+    bool m_empty{true};
+    QString m_error;
+    std::optional<TextMatcher> m_matcher;
+    std::optional<QRegularExpression> m_regex;
+    std::u16string m_required;
+};
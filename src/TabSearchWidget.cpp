@@ -0,0 +1,372 @@
+#include "TabSearchWidget.hpp"
+
+#include <QHBoxLayout>
+#include <QShortcut>
+#include <QThread>
+#include <algorithm>
+
+namespace
+{
+constexpr int PageRole   = Qt::UserRole;
+constexpr int PosRole    = Qt::UserRole + 1;
+constexpr int PathRole   = Qt::UserRole + 2;
+constexpr int CountRole  = Qt::UserRole + 3;
+constexpr int ListedRole = Qt::UserRole + 4;
+
+QString
+groupLabel(const QString &title, int count) noexcept
+{
+    return QString("%1 (%2)").arg(title).arg(count);
+}
+} // namespace
+
+TabSearchWidget::TabSearchWidget(QWidget *parent) : QWidget(parent)
+{
+    setWindowTitle("Search All Tabs");
+    setMinimumSize(640, 420);
+
+    m_spinner = new WaitingSpinnerWidget(this, false, false);
+    m_spinner->setInnerRadius(5);
+    m_spinner->setColor(palette().color(QPalette::Text));
+
+    QLabel *title  = new QLabel("All Tabs", this);
+    m_search_input = new QLineEdit(this);
+    m_search_input->setPlaceholderText("Search all tabs");
+    m_search_input->setFocusPolicy(Qt::StrongFocus);
+    m_tree = new QTreeWidget(this);
+    m_tree->setMinimumHeight(220);
+    m_tree->setHeaderHidden(true);
+    m_tree->setColumnCount(1);
+    m_tree->setUniformRowHeights(true);
+    m_count_label = new QLabel("0 results", this);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    QHBoxLayout *header = new QHBoxLayout();
+    header->addWidget(title);
+    header->addStretch();
+    header->addWidget(m_spinner);
+    layout->addLayout(header);
+
+    layout->addWidget(m_search_input);
+    layout->addWidget(m_tree, 1);
+
+    QHBoxLayout *footer = new QHBoxLayout();
+    footer->addWidget(m_count_label);
+    footer->addStretch();
+    layout->addLayout(footer);
+
+    connect(m_search_input, &QLineEdit::returnPressed, this,
+            [this]() { emit searchRequested(m_search_input->text()); });
+
+    // Enter and double click
+    connect(m_tree, &QTreeWidget::itemActivated, this,
+            [this](QTreeWidgetItem *item, int) { activateItem(item); });
+
+    QWidget::setTabOrder(m_search_input, m_tree);
+
+    auto *nextShortcut
+        = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_N), this);
+    nextShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(nextShortcut, &QShortcut::activated, this,
+            [this]() { moveSelection(1); });
+
+    auto *prevShortcut
+        = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_P), this);
+    prevShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(prevShortcut, &QShortcut::activated, this,
+            [this]() { moveSelection(-1); });
+
+    setLoading(false);
+}
+
+TabSearchWidget::~TabSearchWidget()
+{
+    // Open tabs' Models outlive the panel, their callbacks must not reach it
+    cancel();
+}
+
+void
+TabSearchWidget::search(const QString &term, SearchQuery::Options options,
+                        const std::vector<Target> &targets) noexcept
+{
+    cancel();
+    m_tree->clear();
+    m_groups.clear();
+    m_match_count    = 0;
+    m_document_count = 0;
+
+    if (m_search_input->text() != term)
+        m_search_input->setText(term);
+
+    if (term.isEmpty())
+    {
+        updateCount();
+        return;
+    }
+
+    // As in DocumentView::Search()
+    options.case_sensitive
+        = SearchQuery::isSmartCaseSensitive(term, options.regex);
+
+    m_query = std::make_shared<const SearchQuery>(term, options);
+    if (!m_query->isValid())
+    {
+        m_count_label->setText(QString("Invalid regular expression: %1")
+                                   .arg(m_query->errorString()));
+        return;
+    }
+
+    setLoading(true);
+    for (const Target &target : targets)
+    {
+        if (target.model)
+            searchModel(target, target.model);
+        else
+            m_open_queue.push_back(target);
+    }
+    openQueued();
+
+    if (m_pending.empty())
+        setLoading(false);
+    updateCount();
+}
+
+// Opening a document costs a context pool and a share of the memory limit,
+// so tabs that were never loaded are opened a few at a time
+void
+TabSearchWidget::openQueued() noexcept
+{
+    const size_t max_open     = std::max(QThread::idealThreadCount(), 1);
+    const uint64_t generation = m_generation;
+    while (m_owned.size() < max_open && !m_open_queue.empty())
+    {
+        const Target target = std::move(m_open_queue.front());
+        m_open_queue.pop_front();
+
+        // Opened without a view, nothing is laid out or rendered
+        Model *model = new Model(this);
+        model->setTextIndexEnabled(m_text_index_enabled);
+        model->setTextIndexBuildEnabled(false);
+        m_owned.push_back(model);
+        m_pending.push_back(model);
+
+        connect(model, &Model::openFileFinished, this,
+                [this, target, model, generation]()
+        {
+            if (generation == m_generation)
+                searchModel(target, model);
+        });
+        connect(model, &Model::openFileFailed, this,
+                [this, model, generation]()
+        {
+            if (generation == m_generation)
+                documentDone(model);
+        });
+        model->openAsync(target.path);
+    }
+}
+
+void
+TabSearchWidget::searchModel(const Target &target, Model *model) noexcept
+{
+    const uint64_t generation = m_generation;
+    if (std::find(m_pending.begin(), m_pending.end(), model) == m_pending.end())
+        m_pending.push_back(model);
+
+    // A tab closed in the middle of its search never reports back
+    m_connections.push_back(connect(model, &QObject::destroyed, this,
+                                    [this]() { documentDone(nullptr); }));
+
+    QPointer<Model> guard = model;
+    model->searchDocument(
+        m_query,
+        [this, target, guard,
+         generation](const QMap<int, std::vector<Model::SearchHit>> &results)
+    {
+        if (generation == m_generation && guard)
+            addResults(target, guard, results);
+    },
+        [this, guard, generation](int)
+    {
+        if (generation == m_generation)
+            documentDone(guard);
+    });
+}
+
+void
+TabSearchWidget::addResults(
+    const Target &target, Model *model,
+    const QMap<int, std::vector<Model::SearchHit>> &results)
+{
+    QTreeWidgetItem *group = m_groups.value(target.path);
+    if (!group)
+    {
+        group = new QTreeWidgetItem(m_tree);
+        group->setData(0, PathRole, target.path);
+        group->setData(0, CountRole, 0);
+        group->setData(0, ListedRole, 0);
+        group->setToolTip(0, target.path);
+        group->setExpanded(true);
+        m_groups.insert(target.path, group);
+        ++m_document_count;
+    }
+
+    int count  = group->data(0, CountRole).toInt();
+    int listed = group->data(0, ListedRole).toInt();
+    for (auto it = results.cbegin(); it != results.cend(); ++it)
+    {
+        const int page = it.key();
+        count += static_cast<int>(it.value().size());
+        m_match_count += static_cast<int>(it.value().size());
+
+        // Batches come nearest page first, children are kept in page order
+        int row = group->childCount();
+        while (row > 0
+               && group->child(row - 1)->data(0, PageRole).toInt() > page)
+            --row;
+
+        for (const Model::SearchHit &hit : it.value())
+        {
+            if (listed >= MAX_LISTED_HITS)
+                break;
+
+            const QString context = model->searchHitContext(hit);
+            auto *item            = new QTreeWidgetItem();
+            item->setText(0, QString("p%1: %2").arg(page + 1).arg(context));
+            item->setToolTip(0, context);
+            item->setData(0, PageRole, page);
+            const fz_quad &q = hit.quad;
+            item->setData(0, PosRole,
+                          QPointF((q.ul.x + q.ur.x + q.ll.x + q.lr.x) * 0.25,
+                                  (q.ul.y + q.ur.y + q.ll.y + q.lr.y) * 0.25));
+            group->insertChild(row++, item);
+            ++listed;
+        }
+    }
+
+    group->setData(0, CountRole, count);
+    group->setData(0, ListedRole, listed);
+    group->setText(0, groupLabel(target.title, count));
+
+    if (!m_tree->currentItem())
+        m_tree->setCurrentItem(group->child(0));
+    updateCount();
+}
+
+void
+TabSearchWidget::documentDone(Model *model) noexcept
+{
+    // Also drops documents whose Model went away
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+                                   [model](const QPointer<Model> &p)
+    { return !p || p == model; }), m_pending.end());
+
+    auto owned = std::find(m_owned.begin(), m_owned.end(), model);
+    if (model && owned != m_owned.end())
+    {
+        m_owned.erase(owned);
+        model->deleteLater();
+        openQueued();
+    }
+
+    if (m_pending.empty() && m_open_queue.empty())
+        setLoading(false);
+    updateCount();
+}
+
+void
+TabSearchWidget::cancel() noexcept
+{
+    ++m_generation;
+    for (const QMetaObject::Connection &connection : m_connections)
+        disconnect(connection);
+    m_connections.clear();
+
+    for (const QPointer<Model> &model : m_pending)
+    {
+        if (model)
+            model->cancelDocumentSearch();
+    }
+    m_pending.clear();
+    m_open_queue.clear();
+
+    for (const QPointer<Model> &model : m_owned)
+    {
+        if (model)
+            model->deleteLater();
+    }
+    m_owned.clear();
+
+    setLoading(false);
+}
+
+void
+TabSearchWidget::updateCount() noexcept
+{
+    m_count_label->setText(QString("%1 results in %2 documents")
+                               .arg(m_match_count)
+                               .arg(m_document_count));
+}
+
+void
+TabSearchWidget::setLoading(bool state) noexcept
+{
+    if (state)
+    {
+        m_spinner->show();
+        m_spinner->start();
+    }
+    else
+    {
+        m_spinner->hide();
+        m_spinner->stop();
+    }
+}
+
+void
+TabSearchWidget::moveSelection(int delta) noexcept
+{
+    QTreeWidgetItem *item = m_tree->currentItem();
+    if (!item)
+        item = m_tree->topLevelItem(0);
+
+    while (item)
+    {
+        item = delta > 0 ? m_tree->itemBelow(item) : m_tree->itemAbove(item);
+        // Hits only, the document rows are headings
+        if (item && item->parent())
+            break;
+    }
+
+    if (!item)
+        return;
+    m_tree->setCurrentItem(item);
+    m_tree->scrollToItem(item);
+}
+
+void
+TabSearchWidget::activateItem(QTreeWidgetItem *item) noexcept
+{
+    if (!item || !item->parent())
+        return;
+
+    const QString path = item->parent()->data(0, PathRole).toString();
+    const int page     = item->data(0, PageRole).toInt();
+    const QPointF pos  = item->data(0, PosRole).toPointF();
+    emit gotoLocationRequested(path, page, pos);
+}
+
+void
+TabSearchWidget::focusSearchInput() noexcept
+{
+    m_search_input->setFocus();
+    m_search_input->selectAll();
+}
+
+void
+TabSearchWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    focusSearchInput();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Model.hpp"
+#include "WaitingSpinnerWidget.hpp"
+
+#include <QHash>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPointer>
+#include <QTreeWidget>
+#include <QWidget>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Results of one search over every open tab, grouped by document as they
+// stream in. Tabs with a loaded view are searched through their own Model,
+// reusing its cached text; tabs never loaded get a Model without a view that
+// lives only as long as its search.
+class TabSearchWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    struct Target
+    {
+        QString path;
+        QString title;
+        QPointer<Model> model; // null for a tab that is not loaded
+    };
+
+    explicit TabSearchWidget(QWidget *parent = nullptr);
+    ~TabSearchWidget();
+
+    inline void setTextIndexEnabled(bool enabled) noexcept
+    {
+        m_text_index_enabled = enabled;
+    }
+
+    // Replaces the results and stops the previous search
+    void search(const QString &term, SearchQuery::Options options,
+                const std::vector<Target> &targets) noexcept;
+    void cancel() noexcept;
+    void focusSearchInput() noexcept;
+
+signals:
+    // A term was entered, answered with search()
+    void searchRequested(const QString &term);
+    void gotoLocationRequested(const QString &path, int page,
+                               const QPointF &pagePos);
+
+private:
+    void openQueued() noexcept;
+    void searchModel(const Target &target, Model *model) noexcept;
+    void addResults(const Target &target, Model *model,
+                    const QMap<int, std::vector<Model::SearchHit>> &results);
+    void documentDone(Model *model) noexcept;
+    void updateCount() noexcept;
+    void setLoading(bool state) noexcept;
+    void moveSelection(int delta) noexcept;
+    void activateItem(QTreeWidgetItem *item) noexcept;
+
+    // Listing every hit of a common word would only slow the panel down
+    static constexpr int MAX_LISTED_HITS = 500;
+
+    QLineEdit *m_search_input{nullptr};
+    QTreeWidget *m_tree{nullptr};
+    QLabel *m_count_label{nullptr};
+    WaitingSpinnerWidget *m_spinner{nullptr};
+    bool m_text_index_enabled{true};
+    std::shared_ptr<const SearchQuery> m_query;
+    // Bumped by every search, callbacks of an older one are ignored
+    uint64_t m_generation{0};
+    // Documents still being searched, and the Models made for them
+    std::vector<QPointer<Model>> m_pending;
+    std::vector<QPointer<Model>> m_owned;
+    // Tabs never loaded wait here, only a few are opened at a time
+    std::deque<Target> m_open_queue;
+    std::vector<QMetaObject::Connection> m_connections;
+    QHash<QString, QTreeWidgetItem *> m_groups; // by document path
+    int m_document_count{0};
+    int m_match_count{0};
+
+protected:
+    void showEvent(QShowEvent *event) override;
+};
@@ -0,0 +1,231 @@
+#include "TextCache.hpp"
+#include "TextMatcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+size_t
+TextCache::Text::bytes() const noexcept
+{
+    return sizeof(Text)
+           + (chars.capacity() + folded.capacity()) * sizeof(char16_t);
+}
+
+size_t
+TextCache::Geometry::bytes() const noexcept
+{
+    return sizeof(Geometry) + lines.capacity() * sizeof(Line)
+           + (start.capacity() + end.capacity()) * sizeof(float);
+}
+
+fz_rect
+TextCache::Geometry::rangeRect(uint32_t first, uint32_t count) const noexcept
+{
+    fz_rect bbox = fz_empty_rect;
+    if (lines.empty() || count == 0)
+        return bbox;
+
+    const uint32_t last = std::min<uint32_t>(first + count, start.size());
+
+    // Line holding first, the ranges of a search hit rarely span two
+    auto line = std::upper_bound(lines.begin(), lines.end(), first,
+                                 [](uint32_t i, const Line &l)
+    { return i < l.first; });
+    if (line != lines.begin())
+        --line;
+
+    for (uint32_t i = first; i < last; ++i)
+    {
+        while (line + 1 != lines.end() && (line + 1)->first <= i)
+            ++line;
+
+        if (start[i] >= end[i])
+            continue;
+
+        fz_rect r = line->bbox;
+        if (line->vertical)
+        {
+            r.y0 = start[i];
+            r.y1 = end[i];
+        }
+        else
+        {
+            r.x0 = start[i];
+            r.x1 = end[i];
+        }
+        bbox = fz_union_rect(bbox, r);
+    }
+
+    return bbox;
+}
+
+TextCache::TextCache() noexcept
+{
+    // Only the budgets limit the caches
+    for (Shard &shard : m_shards)
+    {
+        shard.text.setCapacity(std::numeric_limits<size_t>::max());
+        shard.geometry.setCapacity(std::numeric_limits<size_t>::max());
+    }
+    setBudgets(DEFAULT_TEXT_BUDGET, DEFAULT_GEOMETRY_BUDGET);
+}
+
+void
+TextCache::extract(const fz_stext_page *stext, Text *text, Geometry *geometry)
+{
+    for (const fz_stext_block *b = stext->first_block; b; b = b->next)
+    {
+        if (b->type != FZ_STEXT_BLOCK_TEXT)
+            continue;
+
+        for (const fz_stext_line *l = b->u.t.first_line; l; l = l->next)
+        {
+            const bool vertical = std::abs(l->dir.y) > std::abs(l->dir.x);
+            if (geometry)
+                geometry->lines.push_back(
+                    {l->bbox, static_cast<uint32_t>(geometry->start.size()),
+                     vertical});
+
+            for (const fz_stext_char *c = l->first_char; c; c = c->next)
+            {
+                const uint32_t rune = static_cast<uint32_t>(c->c);
+                const int units     = rune > 0xFFFF ? 2 : 1;
+
+                if (text)
+                {
+                    if (units == 2)
+                    {
+                        const uint32_t v = rune - 0x10000;
+                        text->chars.push_back(
+                            static_cast<char16_t>(0xD800 + (v >> 10)));
+                        text->chars.push_back(
+                            static_cast<char16_t>(0xDC00 + (v & 0x3FF)));
+                    }
+                    else
+                    {
+                        text->chars.push_back(static_cast<char16_t>(rune));
+                    }
+                }
+
+                if (geometry)
+                {
+                    // Characters without a box get an empty extent
+                    float s = 0.0f, e = 0.0f;
+                    if (!fz_is_empty_quad(c->quad))
+                    {
+                        const fz_rect r = fz_rect_from_quad(c->quad);
+                        s               = vertical ? r.y0 : r.x0;
+                        e               = vertical ? r.y1 : r.x1;
+                    }
+                    geometry->start.insert(geometry->start.end(), units, s);
+                    geometry->end.insert(geometry->end.end(), units, e);
+                }
+            }
+
+            // logical line break (prevents cross-line matches)
+            if (text)
+                text->chars.push_back(u'\n');
+            if (geometry)
+            {
+                geometry->start.push_back(0.0f);
+                geometry->end.push_back(0.0f);
+            }
+        }
+    }
+
+    // Pages are kept for long, do not pay for the growth slack
+    if (text)
+    {
+        text->chars.shrink_to_fit();
+        text->folded = TextMatcher::fold(text->chars);
+    }
+    if (geometry)
+    {
+        geometry->lines.shrink_to_fit();
+        geometry->start.shrink_to_fit();
+        geometry->end.shrink_to_fit();
+    }
+}
+
+void
+TextCache::setBudgets(size_t textBytes, size_t geometryBytes) noexcept
+{
+    for (Shard &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const size_t before = shard.text.weight() + shard.geometry.weight();
+        shard.text.setMaxWeight(textBytes / SHARDS);
+        shard.geometry.setMaxWeight(geometryBytes / SHARDS);
+        updateBytes(shard, before);
+    }
+}
+
+TextCache::TextRef
+TextCache::text(int pageno) noexcept
+{
+    Shard &s = shard(pageno);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const TextRef *text = s.text.get(pageno);
+    return text ? *text : nullptr;
+}
+
+TextCache::GeometryRef
+TextCache::geometry(int pageno) noexcept
+{
+    Shard &s = shard(pageno);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const GeometryRef *geometry = s.geometry.get(pageno);
+    return geometry ? *geometry : nullptr;
+}
+
+TextCache::TextRef
+TextCache::putText(int pageno, Text text) noexcept
+{
+    const size_t bytes = text.bytes();
+    auto ref           = std::make_shared<const Text>(std::move(text));
+
+    Shard &s = shard(pageno);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const size_t before = s.text.weight() + s.geometry.weight();
+    s.text.put(pageno, ref, bytes);
+    updateBytes(s, before);
+    return ref;
+}
+
+TextCache::GeometryRef
+TextCache::putGeometry(int pageno, Geometry geometry) noexcept
+{
+    const size_t bytes = geometry.bytes();
+    auto ref           = std::make_shared<const Geometry>(std::move(geometry));
+
+    Shard &s = shard(pageno);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    const size_t before = s.text.weight() + s.geometry.weight();
+    s.geometry.put(pageno, ref, bytes);
+    updateBytes(s, before);
+    return ref;
+}
+
+void
+TextCache::clear() noexcept
+{
+    for (Shard &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const size_t before = shard.text.weight() + shard.geometry.weight();
+        shard.text.clear();
+        shard.geometry.clear();
+        updateBytes(shard, before);
+    }
+}
+
+void
+TextCache::updateBytes(Shard &shard, size_t before) noexcept
+{
+    const size_t after = shard.text.weight() + shard.geometry.weight();
+    if (after >= before)
+        m_bytes.fetch_add(after - before, std::memory_order_relaxed);
+    else
+        m_bytes.fetch_sub(before - after, std::memory_order_relaxed);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "LRUCache.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <mupdf/fitz.h>
+}
+
+// Extracted text of document pages, kept for searching. A page's characters
+// are one contiguous UTF-16 buffer, which is all a search scans. Their boxes
+// live apart, as line boxes plus per character offsets along the line
+// instead of a quad per character, and are only needed to place hits, so
+// they are evicted first and extracted again for the pages that need them.
+//
+// Both parts are bounded by a byte budget and evicted least recently used
+// first. Pages are spread over independently locked shards and handed out
+// as immutable shared snapshots, so any number of threads can look up, scan
+// and add pages at the same time; a lock is only held for the lookup itself.
+class TextCache
+{
+public:
+    struct Text
+    {
+        // Lines end with '\n' so that matches do not cross them
+        std::u16string chars;
+        // chars with TextMatcher::fold() applied, for case-insensitive search
+        std::u16string folded;
+
+        size_t bytes() const noexcept;
+    };
+
+    struct Geometry
+    {
+        struct Line
+        {
+            fz_rect bbox;
+            uint32_t first; // index of its first code unit in Text::chars
+            bool vertical;  // offsets run along y instead of x
+        };
+
+        std::vector<Line> lines;
+        // Extent of each code unit along its line, the line break included
+        std::vector<float> start;
+        std::vector<float> end;
+
+        // Bounding box of count code units starting at first, empty if they
+        // have no extent (line breaks, whitespace without a glyph box)
+        fz_rect rangeRect(uint32_t first, uint32_t count) const noexcept;
+
+        size_t bytes() const noexcept;
+    };
+
+    using TextRef     = std::shared_ptr<const Text>;
+    using GeometryRef = std::shared_ptr<const Geometry>;
+
+    static constexpr size_t DEFAULT_TEXT_BUDGET     = 64 * 1024 * 1024;
+    static constexpr size_t DEFAULT_GEOMETRY_BUDGET = 32 * 1024 * 1024;
+
+    TextCache() noexcept;
+
+    // Fills text and/or geometry (either may be null) from a text page
+    static void extract(const fz_stext_page *stext, Text *text,
+                        Geometry *geometry);
+
+    void setBudgets(size_t textBytes, size_t geometryBytes) noexcept;
+
+    // Null if the page is not cached. The snapshot stays valid after the
+    // page is evicted.
+    TextRef text(int pageno) noexcept;
+    GeometryRef geometry(int pageno) noexcept;
+
+    TextRef putText(int pageno, Text text) noexcept;
+    GeometryRef putGeometry(int pageno, Geometry geometry) noexcept;
+
+    void clear() noexcept;
+
+    // Held by the cache itself, snapshots still in use elsewhere not included
+    inline size_t bytes() const noexcept
+    {
+        return m_bytes.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Consecutive pages land in different shards, so parallel searches over
+    // page ranges rarely wait for each other
+    static constexpr size_t SHARDS = 8;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        LRUCache<int, TextRef> text;
+        LRUCache<int, GeometryRef> geometry;
+    };
+
+    inline Shard &shard(int pageno) noexcept
+    {
+        return m_shards[static_cast<size_t>(pageno) % SHARDS];
+    }
+
+    // Call with the shard locked, after changing it
+    void updateBytes(Shard &shard, size_t before) noexcept;
+
+    std::array<Shard, SHARDS> m_shards;
+    std::atomic<size_t> m_bytes{0};
+};
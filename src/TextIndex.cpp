@@ -0,0 +1,343 @@
+#include "TextIndex.hpp"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+namespace
+{
+constexpr uint64_t
+padded(uint64_t bytes) noexcept
+{
+    return (bytes + 7) & ~uint64_t{7};
+}
+
+bool
+writePadded(QSaveFile &file, const void *data, uint64_t bytes) noexcept
+{
+    static constexpr char zeros[8]{};
+    const qint64 pad = static_cast<qint64>(padded(bytes) - bytes);
+    return file.write(static_cast<const char *>(data),
+                      static_cast<qint64>(bytes))
+               == static_cast<qint64>(bytes)
+           && file.write(zeros, pad) == pad;
+}
+} // namespace
+
+TextIndex::Key
+TextIndex::Key::of(const QString &filePath) noexcept
+{
+    const QFileInfo info(filePath);
+    Key key;
+    key.path = info.canonicalFilePath();
+    if (key.path.isEmpty())
+        return key;
+
+    key.size  = info.size();
+    key.mtime = info.lastModified().toMSecsSinceEpoch();
+    return key;
+}
+
+QString
+TextIndex::pathFor(const Key &key) noexcept
+{
+    const QString dir
+        = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (dir.isEmpty() || key.path.isEmpty())
+        return QString();
+
+    // One file per document, rebuilt in place when the document changes
+    const QByteArray name = QCryptographicHash::hash(key.path.toUtf8(),
+                                                     QCryptographicHash::Sha1)
+                                .toHex();
+    return QDir(dir).filePath(QStringLiteral("text-index/%1.idx")
+                                  .arg(QString::fromLatin1(name)));
+}
+
+uint32_t
+TextIndex::trigramBit(char16_t a, char16_t b, char16_t c) noexcept
+{
+    static_assert(SIGNATURE_BITS == 1u << 12, "bits taken from the hash");
+    const uint64_t v = (uint64_t{a} << 32) | (uint64_t{b} << 16) | c;
+    return static_cast<uint32_t>((v * 0x9E3779B97F4A7C15ULL) >> 52);
+}
+
+TextIndex::Trigrams
+TextIndex::trigrams(std::u16string_view folded)
+{
+    Trigrams bits;
+    for (size_t i = 0; i + 3 <= folded.size(); ++i)
+        bits.push_back(trigramBit(folded[i], folded[i + 1], folded[i + 2]));
+
+    std::sort(bits.begin(), bits.end());
+    bits.erase(std::unique(bits.begin(), bits.end()), bits.end());
+    return bits;
+}
+
+TextIndex::Builder::Builder(int pageCount) : m_page_count(pageCount)
+{
+    m_pages.reserve(pageCount);
+    m_signatures.reserve(static_cast<size_t>(pageCount) * SIGNATURE_WORDS);
+}
+
+void
+TextIndex::Builder::addPage(const TextCache::Text &text,
+                            const TextCache::Geometry &geometry)
+{
+    // A page's geometry always covers its text, a failed extraction leaves
+    // both empty
+    const size_t units = std::min(text.chars.size(), geometry.start.size());
+
+    m_pages.push_back({static_cast<uint32_t>(m_chars.size()),
+                       static_cast<uint32_t>(units),
+                       static_cast<uint32_t>(m_lines.size()),
+                       static_cast<uint32_t>(geometry.lines.size())});
+
+    const size_t signature = m_signatures.size();
+    m_signatures.resize(signature + SIGNATURE_WORDS, 0);
+    for (size_t i = 0; i + 3 <= units; ++i)
+    {
+        const uint32_t bit = trigramBit(text.folded[i], text.folded[i + 1],
+                                        text.folded[i + 2]);
+        m_signatures[signature + bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+
+    m_chars.append(text.chars, 0, units);
+    m_folded.append(text.folded, 0, units);
+    m_start.insert(m_start.end(), geometry.start.begin(),
+                   geometry.start.begin() + units);
+    m_end.insert(m_end.end(), geometry.end.begin(),
+                 geometry.end.begin() + units);
+
+    for (const TextCache::Geometry::Line &l : geometry.lines)
+        m_lines.push_back({l.bbox.x0, l.bbox.y0, l.bbox.x1, l.bbox.y1,
+                           l.first, l.vertical ? 1u : 0u});
+}
+
+bool
+TextIndex::Builder::write(const QString &path, const Key &key) const noexcept
+{
+    if (path.isEmpty() || static_cast<int>(m_pages.size()) != m_page_count)
+        return false;
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    const QByteArray path_utf8 = key.path.toUtf8();
+
+    Header header{};
+    header.magic      = MAGIC;
+    header.version    = VERSION;
+    header.size       = key.size;
+    header.mtime      = key.mtime;
+    header.page_count = static_cast<uint32_t>(m_page_count);
+    header.path_bytes = static_cast<uint32_t>(path_utf8.size());
+    header.units      = m_chars.size();
+    header.lines      = m_lines.size();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const bool ok
+        = writePadded(file, &header, sizeof(header))
+          && writePadded(file, path_utf8.constData(), path_utf8.size())
+          && writePadded(file, m_pages.data(), m_pages.size() * sizeof(Page))
+          && writePadded(file, m_signatures.data(),
+                         m_signatures.size() * sizeof(uint64_t))
+          && writePadded(file, m_chars.data(),
+                         m_chars.size() * sizeof(char16_t))
+          && writePadded(file, m_folded.data(),
+                         m_folded.size() * sizeof(char16_t))
+          && writePadded(file, m_lines.data(), m_lines.size() * sizeof(Line))
+          && writePadded(file, m_start.data(), m_start.size() * sizeof(float))
+          && writePadded(file, m_end.data(), m_end.size() * sizeof(float));
+
+    if (!ok)
+    {
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit())
+        return false;
+
+    prune(QFileInfo(path).absolutePath(), path);
+    return true;
+}
+
+void
+TextIndex::prune(const QString &dir, const QString &keep) noexcept
+{
+    // Oldest first, open() bumps the modification time of a file it opens
+    const QFileInfoList files
+        = QDir(dir).entryInfoList({QStringLiteral("*.idx")}, QDir::Files,
+                                  QDir::Time | QDir::Reversed);
+
+    qint64 total = 0;
+    for (const QFileInfo &info : files)
+        total += info.size();
+
+    const QString kept = QFileInfo(keep).absoluteFilePath();
+    for (const QFileInfo &info : files)
+    {
+        if (total <= MAX_CACHE_BYTES)
+            break;
+        if (info.absoluteFilePath() == kept
+            || !QFile::remove(info.absoluteFilePath()))
+            continue;
+        total -= info.size();
+    }
+}
+
+std::shared_ptr<const TextIndex>
+TextIndex::open(const QString &path, const Key &key, int pageCount) noexcept
+{
+    if (path.isEmpty() || key.path.isEmpty() || pageCount <= 0)
+        return nullptr;
+
+    std::shared_ptr<TextIndex> index(new TextIndex);
+    index->m_file.setFileName(path);
+    if (!index->m_file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const qint64 file_size = index->m_file.size();
+    if (file_size < static_cast<qint64>(sizeof(Header)))
+        return nullptr;
+
+    const uchar *data = index->m_file.map(0, file_size);
+    if (!data)
+        return nullptr;
+
+    const Header *header       = reinterpret_cast<const Header *>(data);
+    const QByteArray path_utf8 = key.path.toUtf8();
+    if (header->magic != MAGIC || header->version != VERSION
+        || header->size != key.size || header->mtime != key.mtime
+        || header->page_count != static_cast<uint32_t>(pageCount)
+        || header->path_bytes != static_cast<uint32_t>(path_utf8.size()))
+        return nullptr;
+
+    const uint64_t units = header->units;
+    const uint64_t lines = header->lines;
+    if (units > UINT32_MAX || lines > UINT32_MAX)
+        return nullptr;
+
+    // Section offsets follow from the counts, the file must be exactly that
+    // long
+    uint64_t offset = 0;
+    auto section    = [&offset](uint64_t bytes)
+    {
+        const uint64_t at = offset;
+        offset += padded(bytes);
+        return at;
+    };
+    section(sizeof(Header));
+    const uint64_t path_offset  = section(header->path_bytes);
+    const uint64_t pages_offset = section(pageCount * sizeof(Page));
+    const uint64_t signatures_offset
+        = section(pageCount * SIGNATURE_WORDS * sizeof(uint64_t));
+    const uint64_t chars_offset  = section(units * sizeof(char16_t));
+    const uint64_t folded_offset = section(units * sizeof(char16_t));
+    const uint64_t lines_offset  = section(lines * sizeof(Line));
+    const uint64_t start_offset  = section(units * sizeof(float));
+    const uint64_t end_offset    = section(units * sizeof(float));
+
+    if (offset != static_cast<uint64_t>(file_size)
+        || QByteArray::fromRawData(
+               reinterpret_cast<const char *>(data + path_offset),
+               header->path_bytes)
+               != path_utf8)
+        return nullptr;
+
+    index->m_page_count = pageCount;
+
+    index->m_pages = reinterpret_cast<const Page *>(data + pages_offset);
+    index->m_signatures
+        = reinterpret_cast<const uint64_t *>(data + signatures_offset);
+    index->m_chars  = reinterpret_cast<const char16_t *>(data + chars_offset);
+    index->m_folded = reinterpret_cast<const char16_t *>(data + folded_offset);
+    index->m_lines  = reinterpret_cast<const Line *>(data + lines_offset);
+    index->m_start  = reinterpret_cast<const float *>(data + start_offset);
+    index->m_end    = reinterpret_cast<const float *>(data + end_offset);
+
+    // Pages are trusted from here on
+    for (int i = 0; i < pageCount; ++i)
+    {
+        const Page &page = index->m_pages[i];
+        if (uint64_t{page.first_unit} + page.units > units
+            || uint64_t{page.first_line} + page.lines > lines)
+            return nullptr;
+        for (uint32_t l = 0; l < page.lines; ++l)
+        {
+            if (index->m_lines[page.first_line + l].first > page.units)
+                return nullptr;
+        }
+    }
+
+    // Recently used files survive prune()
+    index->m_file.setFileTime(QDateTime::currentDateTime(),
+                              QFileDevice::FileModificationTime);
+    return index;
+}
+
+std::u16string_view
+TextIndex::chars(int pageno) const noexcept
+{
+    if (pageno < 0 || pageno >= m_page_count)
+        return {};
+
+    const Page &page = m_pages[pageno];
+    return {m_chars + page.first_unit, page.units};
+}
+
+std::u16string_view
+TextIndex::folded(int pageno) const noexcept
+{
+    if (pageno < 0 || pageno >= m_page_count)
+        return {};
+
+    const Page &page = m_pages[pageno];
+    return {m_folded + page.first_unit, page.units};
+}
+
+TextCache::Geometry
+TextIndex::geometry(int pageno) const
+{
+    TextCache::Geometry geometry;
+    if (pageno < 0 || pageno >= m_page_count)
+        return geometry;
+
+    const Page &page = m_pages[pageno];
+    geometry.lines.reserve(page.lines);
+    for (uint32_t i = 0; i < page.lines; ++i)
+    {
+        const Line &l = m_lines[page.first_line + i];
+        geometry.lines.push_back(
+            {fz_rect{l.x0, l.y0, l.x1, l.y1}, l.first, l.vertical != 0});
+    }
+
+    geometry.start.assign(m_start + page.first_unit,
+                          m_start + page.first_unit + page.units);
+    geometry.end.assign(m_end + page.first_unit,
+                        m_end + page.first_unit + page.units);
+    return geometry;
+}
+
+bool
+TextIndex::mayContain(int pageno, const Trigrams &trigrams) const noexcept
+{
+    if (pageno < 0 || pageno >= m_page_count)
+        return false;
+
+    const uint64_t *signature
+        = m_signatures + static_cast<size_t>(pageno) * SIGNATURE_WORDS;
+    for (const uint32_t bit : trigrams)
+    {
+        if (!(signature[bit / 64] & (uint64_t{1} << (bit % 64))))
+            return false;
+    }
+    return true;
+}
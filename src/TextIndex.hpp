@@ -0,0 +1,152 @@
+#pragma once
+
+#include "TextCache.hpp"
+
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Text of a whole document saved to disk, so that searching a document
+// opened before needs no text extraction at all. The file holds every page's
+// characters, their case-folded copy and geometry in the layout of
+// TextCache, plus a trigram signature per page that rules out most pages
+// without a match before they are scanned.
+//
+// Files live in the cache directory, one per document path, and are memory
+// mapped: opening one costs no reads and its pages stay in the page cache of
+// the OS, not in the heap. A file only opens for the same path, size and
+// modification time it was built for; a changed document gets a new one.
+// Opening a file marks it used, and writing one deletes the least recently
+// used ones beyond MAX_CACHE_BYTES.
+class TextIndex
+{
+public:
+    // Identifies the document file an index was built from
+    struct Key
+    {
+        QString path; // canonical
+        qint64 size{0};
+        qint64 mtime{0}; // ms since the epoch
+
+        // Empty path if the file does not exist
+        static Key of(const QString &filePath) noexcept;
+    };
+
+    // Bits of a pattern's trigrams in the page signatures
+    using Trigrams = std::vector<uint32_t>;
+
+    // Collects pages in order and writes them as an index file
+    class Builder;
+
+    // Where the index of the document at key.path is kept
+    static QString pathFor(const Key &key) noexcept;
+
+    // Null if there is no valid index for key with pageCount pages
+    static std::shared_ptr<const TextIndex>
+    open(const QString &path, const Key &key, int pageCount) noexcept;
+
+    TextIndex(const TextIndex &)            = delete;
+    TextIndex &operator=(const TextIndex &) = delete;
+
+    inline int pageCount() const noexcept
+    {
+        return m_page_count;
+    }
+
+    // Views into the mapped file, valid as long as the index
+    std::u16string_view chars(int pageno) const noexcept;
+    std::u16string_view folded(int pageno) const noexcept;
+
+    // Copies of one page, to be cached like freshly extracted ones
+    TextCache::Geometry geometry(int pageno) const;
+
+    // Trigrams of a case-folded pattern, empty if it is too short to have
+    // any, which lets every page through
+    static Trigrams trigrams(std::u16string_view folded);
+
+    // False only if the page cannot contain a pattern with these trigrams
+    bool mayContain(int pageno, const Trigrams &trigrams) const noexcept;
+
+private:
+    // File layout: Header, the document path, a Page per page, the page
+    // signatures, then all pages' chars, folded chars, lines, start and end
+    // offsets, each section padded to 8 bytes
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        qint64 size;
+        qint64 mtime;
+        uint32_t page_count;
+        uint32_t path_bytes;
+        uint64_t units; // code units of all pages
+        uint64_t lines; // lines of all pages
+    };
+
+    struct Page
+    {
+        uint32_t first_unit;
+        uint32_t units;
+        uint32_t first_line;
+        uint32_t lines;
+    };
+
+    // TextCache::Geometry::Line without padding of unknown content
+    struct Line
+    {
+        float x0, y0, x1, y1;
+        uint32_t first; // relative to the page
+        uint32_t vertical;
+    };
+
+    static constexpr uint32_t MAGIC   = 0x5844494C; // "LIDX"
+    static constexpr uint32_t VERSION = 1;
+    // Per page, hashed trigrams of the folded text
+    static constexpr uint32_t SIGNATURE_BITS  = 4096;
+    static constexpr uint32_t SIGNATURE_WORDS = SIGNATURE_BITS / 64;
+    // All index files together, the least recently opened go first
+    static constexpr qint64 MAX_CACHE_BYTES = qint64{512} << 20;
+
+    static uint32_t trigramBit(char16_t a, char16_t b, char16_t c) noexcept;
+    // Deletes the least recently used files of dir until they fit in
+    // MAX_CACHE_BYTES, never keep
+    static void prune(const QString &dir, const QString &keep) noexcept;
+
+    TextIndex() noexcept = default;
+
+    QFile m_file;
+    int m_page_count{0};
+    const Page *m_pages{nullptr};
+    const uint64_t *m_signatures{nullptr};
+    const char16_t *m_chars{nullptr};
+    const char16_t *m_folded{nullptr};
+    const Line *m_lines{nullptr};
+    const float *m_start{nullptr};
+    const float *m_end{nullptr};
+};
+
+class TextIndex::Builder
+{
+public:
+    explicit Builder(int pageCount);
+
+    void addPage(const TextCache::Text &text,
+                 const TextCache::Geometry &geometry);
+
+    // Replaces the file at path atomically, false on failure or if not
+    // every page was added
+    bool write(const QString &path, const Key &key) const noexcept;
+
+private:
+    int m_page_count;
+    std::vector<Page> m_pages;
+    std::vector<uint64_t> m_signatures;
+    std::u16string m_chars;
+    std::u16string m_folded;
+    std::vector<Line> m_lines;
+    std::vector<float> m_start;
+    std::vector<float> m_end;
+};
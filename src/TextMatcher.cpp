@@ -0,0 +1,211 @@
+#include "TextMatcher.hpp"
+
+#include <cstring>
+
+extern "C"
+{
+#include <mupdf/fitz.h>
+}
+
+#if (defined(__x86_64__) || defined(__i386__))                                \
+    && (defined(__GNUC__) || defined(__clang__))
+#define TEXT_MATCHER_X86 1
+#include <immintrin.h>
+#endif
+
+// The vector kernels compare the first and last code units of the pattern
+// against the text at a whole vector of positions, and only positions where
+// both match are checked in full. Both go back to the scalar kernel for the
+// tail that does not fill a vector.
+struct TextMatcher::Kernel
+{
+    using Fn = void (*)(std::u16string_view, std::u16string_view,
+                        std::vector<uint32_t> &);
+
+    // Whether the code units between the first and the last match
+    static inline bool middleEqual(const char16_t *text,
+                                   std::u16string_view pattern) noexcept
+    {
+        return pattern.size() <= 2
+               || std::memcmp(text + 1, pattern.data() + 1,
+                              (pattern.size() - 2) * sizeof(char16_t))
+                      == 0;
+    }
+
+    // Matches starting at from or later
+    static void scalarFrom(std::u16string_view text,
+                           std::u16string_view pattern,
+                           std::vector<uint32_t> &out, size_t from) noexcept
+    {
+        const size_t m       = pattern.size();
+        const char16_t first = pattern.front();
+        const char16_t last  = pattern.back();
+        for (size_t i = from; i + m <= text.size(); ++i)
+        {
+            if (text[i] == first && text[i + m - 1] == last
+                && middleEqual(text.data() + i, pattern))
+                out.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    static void scalar(std::u16string_view text, std::u16string_view pattern,
+                       std::vector<uint32_t> &out) noexcept
+    {
+        scalarFrom(text, pattern, out, 0);
+    }
+
+#ifdef TEXT_MATCHER_X86
+    // movemask gives two bits per 16 bit lane
+    static inline void collect(const char16_t *text,
+                               std::u16string_view pattern, size_t i,
+                               uint32_t mask,
+                               std::vector<uint32_t> &out) noexcept
+    {
+        while (mask)
+        {
+            const int bit    = __builtin_ctz(mask);
+            const size_t pos = i + bit / 2;
+            if (middleEqual(text + pos, pattern))
+                out.push_back(static_cast<uint32_t>(pos));
+            mask &= ~(3u << bit);
+        }
+    }
+
+    __attribute__((target("sse2"))) static void
+    sse2(std::u16string_view text, std::u16string_view pattern,
+         std::vector<uint32_t> &out) noexcept
+    {
+        const size_t m      = pattern.size();
+        const char16_t *t   = text.data();
+        const __m128i first = _mm_set1_epi16(pattern.front());
+        const __m128i last  = _mm_set1_epi16(pattern.back());
+
+        size_t i = 0;
+        for (; i + m - 1 + 8 <= text.size(); i += 8)
+        {
+            const __m128i a
+                = _mm_loadu_si128(reinterpret_cast<const __m128i *>(t + i));
+            const __m128i b = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(t + i + m - 1));
+            const __m128i eq = _mm_and_si128(_mm_cmpeq_epi16(a, first),
+                                             _mm_cmpeq_epi16(b, last));
+            collect(t, pattern, i,
+                    static_cast<uint32_t>(_mm_movemask_epi8(eq)), out);
+        }
+
+        scalarFrom(text, pattern, out, i);
+    }
+
+    __attribute__((target("avx2"))) static void
+    avx2(std::u16string_view text, std::u16string_view pattern,
+         std::vector<uint32_t> &out) noexcept
+    {
+        const size_t m      = pattern.size();
+        const char16_t *t   = text.data();
+        const __m256i first = _mm256_set1_epi16(pattern.front());
+        const __m256i last  = _mm256_set1_epi16(pattern.back());
+
+        size_t i = 0;
+        for (; i + m - 1 + 16 <= text.size(); i += 16)
+        {
+            const __m256i a
+                = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(t + i));
+            const __m256i b = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(t + i + m - 1));
+            const __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi16(a, first),
+                                                _mm256_cmpeq_epi16(b, last));
+            collect(t, pattern, i,
+                    static_cast<uint32_t>(_mm256_movemask_epi8(eq)), out);
+        }
+
+        scalarFrom(text, pattern, out, i);
+    }
+#endif
+
+    struct Selected
+    {
+        Fn fn;
+        const char *name;
+    };
+
+    static Selected select() noexcept
+    {
+#ifdef TEXT_MATCHER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return {avx2, "avx2"};
+        if (__builtin_cpu_supports("sse2"))
+            return {sse2, "sse2"};
+#endif
+        return {scalar, "scalar"};
+    }
+
+    static const Selected &selected() noexcept
+    {
+        static const Selected kernel = select();
+        return kernel;
+    }
+};
+
+TextMatcher::TextMatcher(std::u16string_view pattern) : m_pattern(pattern)
+{
+    const size_t m = m_pattern.size();
+    if (m < HORSPOOL_MIN_LENGTH || Kernel::selected().fn != Kernel::scalar)
+        return;
+
+    // Code units are bucketed by their low byte, sharing a bucket only
+    // makes a shift shorter, never wrong
+    m_shift.assign(256, static_cast<uint32_t>(m));
+    for (size_t k = 0; k + 1 < m; ++k)
+        m_shift[m_pattern[k] & 0xFF] = static_cast<uint32_t>(m - 1 - k);
+}
+
+void
+TextMatcher::findAll(std::u16string_view text,
+                     std::vector<uint32_t> &out) const noexcept
+{
+    const size_t m = m_pattern.size();
+    if (m == 0 || text.size() < m)
+        return;
+
+    if (m_shift.empty())
+    {
+        Kernel::selected().fn(text, m_pattern, out);
+        return;
+    }
+
+    const char16_t last = m_pattern.back();
+    for (size_t i = 0; i + m <= text.size();)
+    {
+        const char16_t c = text[i + m - 1];
+        if (c == last && text[i] == m_pattern.front()
+            && Kernel::middleEqual(text.data() + i, m_pattern))
+            out.push_back(static_cast<uint32_t>(i));
+        i += m_shift[c & 0xFF];
+    }
+}
+
+char16_t
+TextMatcher::fold(char16_t c) noexcept
+{
+    if (c >= 0xD800 && c <= 0xDFFF)
+        return c;
+
+    const int lower = fz_tolower(c);
+    return lower >= 0 && lower <= 0xFFFF ? static_cast<char16_t>(lower) : c;
+}
+
+std::u16string
+TextMatcher::fold(std::u16string_view text)
+{
+    std::u16string folded(text.size(), u'\0');
+    for (size_t i = 0; i < text.size(); ++i)
+        folded[i] = fold(text[i]);
+    return folded;
+}
+
+const char *
+TextMatcher::kernelName() noexcept
+{
+    return Kernel::selected().name;
+}
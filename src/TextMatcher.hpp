@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Finds every occurrence of a pattern in UTF-16 text, overlapping ones
+// included. The first and last code units of the pattern are compared
+// against a whole vector of positions at once and only the candidates are
+// checked in full, using the widest instruction set the CPU supports. Without
+// vector instructions, long patterns use Boyer-Moore-Horspool instead, which
+// skips ahead by up to the pattern length.
+//
+// Case-insensitive searches fold the pattern with fold() and scan text
+// folded the same way ahead of time, so matching itself never folds.
+class TextMatcher
+{
+public:
+    explicit TextMatcher(std::u16string_view pattern);
+
+    // Appends the position of every match to out, in order
+    void findAll(std::u16string_view text,
+                 std::vector<uint32_t> &out) const noexcept;
+
+    inline size_t size() const noexcept
+    {
+        return m_pattern.size();
+    }
+
+    // Simple lowercase mapping of one code unit, surrogates are left as is
+    static char16_t fold(char16_t c) noexcept;
+    static std::u16string fold(std::u16string_view text);
+
+    // Name of the kernel findAll() dispatches to, for diagnostics
+    static const char *kernelName() noexcept;
+
+    struct Kernel;
+
+private:
+    // Patterns at least this long use Boyer-Moore-Horspool with the scalar
+    // kernel. The vector kernels beat it at any length measured (up to 150).
+    static constexpr size_t HORSPOOL_MIN_LENGTH = 32;
+
+    std::u16string m_pattern;
+    // Horspool shift by the low byte of the code unit under the pattern's
+    // last position, only filled for long patterns
+    std::vector<uint32_t> m_shift;
+};
@@ -49,6 +49,7 @@ public:
         if (!m_model || m_annotations.empty())
             return;
 
+        std::lock_guard<std::mutex> doc_lock(m_model->m_doc_mutex);
         fz_context *ctx   = m_model->m_ctx;
         fz_document *doc  = m_model->m_doc;
         pdf_document *pdf = pdf_specifics(ctx, doc);
@@ -145,6 +146,7 @@ public:
         if (!m_model || m_annotations.empty())
             return;
 
+        std::lock_guard<std::mutex> doc_lock(m_model->m_doc_mutex);
         fz_context *ctx   = m_model->m_ctx;
         fz_document *doc  = m_model->m_doc;
         pdf_document *pdf = pdf_specifics(ctx, doc);
@@ -197,6 +199,7 @@ private:
         if (!m_model || objNums.isEmpty())
             return;
 
+        std::lock_guard<std::mutex> doc_lock(m_model->m_doc_mutex);
         fz_context *ctx   = m_model->m_ctx;
         fz_document *doc  = m_model->m_doc;
         pdf_document *pdf = pdf_specifics(ctx, doc);
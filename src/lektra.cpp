@@ -233,6 +233,10 @@ lektra::initMenubar() noexcept
 
     m_actionHighlightSearch = m_viewMenu->addAction(
         "Search Highlights", this, &lektra::ShowHighlightSearch);
+    m_actionSearchAllTabs = m_viewMenu->addAction(
+        QString("Search All Tabs\t%1")
+            .arg(m_config.shortcuts["search_all_tabs"]),
+        this, &lektra::SearchAllTabs);
 
     m_viewMenu->addSeparator();
 
@@ -680,13 +684,13 @@ lektra::initConfig() noexcept
     set_if_present(ui_highlight_search["panel_width"],
                    m_config.ui.highlight_search.panel_width);
 
-    // if (m_config.ui.tabs.suspend_inactive)
-    // {
-    //     m_idle_clock.start();
-    //     m_suspend_timer.setSingleShot(true);
-    //     connect(&m_suspend_timer, &QTimer::timeout, this,
-    //             &lektra::suspendExpiredTabs);
-    // }
+    if (m_config.ui.tabs.suspend_inactive && !m_idle_clock.isValid())
+    {
+        m_idle_clock.start();
+        m_suspend_timer.setSingleShot(true);
+        connect(&m_suspend_timer, &QTimer::timeout, this,
+                &lektra::suspendExpiredTabs, Qt::UniqueConnection);
+    }
 
 #ifdef ENABLE_LLM_SUPPORT
     auto llm_widget = ui["llm_widget"];
@@ -731,6 +735,18 @@ lektra::initConfig() noexcept
                    m_config.rendering.antialiasing_bits);
     set_if_present(rendering["icc_color_profile"],
                    m_config.rendering.icc_color_profile);
+    set_if_present(rendering["max_concurrent_renders"],
+                   m_config.rendering.max_concurrent_renders);
+    set_if_present(rendering["render_cache_mb"],
+                   m_config.rendering.render_cache_mb);
+    set_if_present(rendering["page_cache_mb"],
+                   m_config.rendering.page_cache_mb);
+    set_if_present(rendering["memory_limit_mb"],
+                   m_config.rendering.memory_limit_mb);
+    set_if_present(rendering["tile_threshold_mp"],
+                   m_config.rendering.tile_threshold_mp);
+    set_if_present(rendering["preview_scale"],
+                   m_config.rendering.preview_scale);
 
     // If DPR is specified in config, use that (can be scalar or map)
     if (rendering["dpr"])
@@ -800,6 +816,7 @@ lektra::initConfig() noexcept
     set_if_present(behavior["config_auto_reload"],
                    m_config.behavior.config_auto_reload);
     set_if_present(behavior["recent_files"], m_config.behavior.recent_files);
+    set_if_present(behavior["search_index"], m_config.behavior.search_index);
     set_if_present(behavior["num_recent_files"],
                    m_config.behavior.num_recent_files);
     set_if_present(behavior["cache_pages"], m_config.behavior.cache_pages);
@@ -851,6 +868,7 @@ lektra::initDefaultKeybinds() noexcept
         {"auto_resize", "Ctrl+Shift+R"},
         {"outline", "t"},
         {"highlight_annot_search", "Alt+Shift+H"},
+        {"search_all_tabs", "Alt+Shift+F"},
         {"prev_location", "Ctrl+o"},
         {"next_location", "Ctrl+i"},
         {"text_select_mode", "1"},
@@ -1940,6 +1958,104 @@ lektra::ShowHighlightSearch() noexcept
     }
 }
 
+// Show the panel searching every open tab
+void
+lektra::SearchAllTabs() noexcept
+{
+    if (!m_tab_search_widget)
+    {
+        m_tab_search_widget = new TabSearchWidget(this);
+        m_tab_search_widget->setWindowFlags(Qt::Dialog);
+        m_tab_search_widget->setWindowModality(Qt::NonModal);
+        m_tab_search_widget->setTextIndexEnabled(
+            m_config.behavior.search_index);
+
+        connect(m_tab_search_widget, &TabSearchWidget::searchRequested, this,
+                &lektra::searchAllTabs);
+        connect(m_tab_search_widget, &TabSearchWidget::gotoLocationRequested,
+                this, &lektra::gotoTabLocation);
+    }
+
+    m_tab_search_widget->show();
+    m_tab_search_widget->raise();
+    m_tab_search_widget->activateWindow();
+}
+
+// Searches every document tab at once. Loaded tabs are searched by their own
+// Model, so pages they extracted already are not extracted again; tabs that
+// were never shown are opened without a view just for the search.
+void
+lektra::searchAllTabs(const QString &term) noexcept
+{
+    std::vector<TabSearchWidget::Target> targets;
+    for (int i = 0; i < m_tab_widget->count(); ++i)
+    {
+        QWidget *widget       = m_tab_widget->widget(i);
+        const QString tabRole = widget->property("tabRole").toString();
+
+        TabSearchWidget::Target target;
+        target.title = m_tab_widget->tabText(i);
+        if (tabRole == "lazy")
+        {
+            target.path = widget->property("filePath").toString();
+        }
+        else if (DocumentView *doc = qobject_cast<DocumentView *>(widget))
+        {
+            target.path = doc->filePath();
+            // A suspended tab has closed its document
+            if (!doc->isSuspended())
+                target.model = doc->model();
+        }
+
+        if (target.path.isEmpty())
+            continue;
+
+        // A file open in several tabs is searched once, preferably through a
+        // loaded one
+        auto seen = std::find_if(targets.begin(), targets.end(),
+                                 [&target](const TabSearchWidget::Target &t)
+        { return t.path == target.path; });
+        if (seen == targets.end())
+            targets.push_back(std::move(target));
+        else if (!seen->model)
+            seen->model = target.model;
+    }
+
+    m_tab_search_widget->search(term, m_search_bar->options(), targets);
+}
+
+// Switches to the tab of filePath, loading it first if it never was
+void
+lektra::gotoTabLocation(const QString &filePath, int page,
+                        const QPointF &pos) noexcept
+{
+    QWidget *widget = m_path_tab_hash.value(filePath);
+    if (!widget || m_tab_widget->indexOf(widget) == -1)
+        return;
+
+    const bool lazy = widget->property("tabRole").toString() == "lazy";
+    m_tab_widget->setCurrentWidget(widget);
+
+    // Replaced by its DocumentView by handleCurrentTabChanged()
+    DocumentView *doc
+        = qobject_cast<DocumentView *>(m_path_tab_hash.value(filePath));
+    if (!doc)
+        return;
+
+    const DocumentView::PageLocation location{page, (float)pos.x(),
+                                              (float)pos.y()};
+    if (!lazy)
+    {
+        doc->GotoLocationWithHistory(location);
+        return;
+    }
+
+    // After the page the tab was last read at is restored
+    connect(doc, &DocumentView::openFileFinished, this,
+            [location](DocumentView *view)
+    { view->GotoLocationWithHistory(location); }, Qt::SingleShotConnection);
+}
+
 // Invert colors of the document
 void
 lektra::InvertColor() noexcept
@@ -2134,7 +2250,7 @@ lektra::initConnections() noexcept
             [this](const QString &term)
     {
         if (m_doc)
-            m_doc->Search(term);
+            m_doc->Search(term, m_search_bar->options());
     });
 
     connect(m_search_bar, &SearchBar::searchIndexChangeRequested, this,
@@ -2148,6 +2264,11 @@ lektra::initConnections() noexcept
         QWidget *widget = m_tab_widget->widget(index);
         if (!widget)
             return;
+
+        m_tab_idle_hash.remove(widget);
+        if (m_previous_tab == widget)
+            m_previous_tab = nullptr;
+
         const QString tabRole = widget->property("tabRole").toString();
         if (tabRole == "doc")
         {
@@ -2216,19 +2337,97 @@ lektra::handleFileNameChanged(const QString &name) noexcept
     this->setWindowTitle(name);
 }
 
+// Suspends the tabs that have been in the background for longer than
+// ui.tabs.suspend_timeout
+void
+lektra::suspendExpiredTabs() noexcept
+{
+    const qint64 now = m_idle_clock.elapsed();
+    const qint64 timeout
+        = static_cast<qint64>(std::max(1, m_config.ui.tabs.suspend_timeout))
+          * 1000;
+    QWidget *current = m_tab_widget->currentWidget();
+
+    for (auto it = m_tab_idle_hash.begin(); it != m_tab_idle_hash.end();)
+    {
+        // Compared before use, the tab may have been closed or replaced
+        QWidget *widget = it.key();
+        if (widget == current || m_tab_widget->indexOf(widget) == -1)
+        {
+            it = m_tab_idle_hash.erase(it);
+            continue;
+        }
+
+        TabIdleState &s = it.value();
+        if (s.suspended || now - s.hidden_ms < timeout)
+        {
+            ++it;
+            continue;
+        }
+
+        // Only documents are suspended
+        DocumentView *doc = qobject_cast<DocumentView *>(widget);
+        if (!doc)
+        {
+            it = m_tab_idle_hash.erase(it);
+            continue;
+        }
+
+        // Unsaved changes keep the tab alive, try again later
+        if (doc->suspend())
+            s.suspended = true;
+        else
+            s.hidden_ms = now;
+        ++it;
+    }
+
+    armNextSuspendDeadline();
+}
+
+void
+lektra::armNextSuspendDeadline() noexcept
+{
+    const qint64 timeout
+        = static_cast<qint64>(std::max(1, m_config.ui.tabs.suspend_timeout))
+          * 1000;
+    qint64 next = -1;
+    for (const TabIdleState &s : std::as_const(m_tab_idle_hash))
+    {
+        if (s.suspended)
+            continue;
+        const qint64 deadline = s.hidden_ms + timeout;
+        if (next < 0 || deadline < next)
+            next = deadline;
+    }
+
+    if (next < 0)
+    {
+        m_suspend_timer.stop();
+        return;
+    }
+
+    m_suspend_timer.start(
+        static_cast<int>(std::max<qint64>(0, next - m_idle_clock.elapsed())));
+}
+
 // Handle when the current tab is changed
 void
 lektra::handleCurrentTabChanged(int index) noexcept
 {
-    // const qint64 now = m_idle_clock.elapsed();
+    if (m_config.ui.tabs.suspend_inactive && m_idle_clock.isValid())
+    {
+        QWidget *current = m_tab_widget->currentWidget();
+        if (m_previous_tab && m_previous_tab != current)
+        {
+            TabIdleState &s = m_tab_idle_hash[m_previous_tab];
+            if (!s.suspended)
+                s.hidden_ms = m_idle_clock.elapsed();
+        }
 
-    // if (m_previous_tab && m_previous_tab !=
-    // m_tab_widget->currentWidget())
-    // {
-    //     auto &s = m_tab_idle_hash[m_previous_tab];
-    //     if (!s.suspended)
-    //         s.hidden_ms = now;
-    // }
+        m_tab_idle_hash.remove(current);
+        m_previous_tab = current;
+        armNextSuspendDeadline();
+    }
 
     if (index == -1)
     {
@@ -2340,6 +2539,10 @@ lektra::handleCurrentTabChanged(int index) noexcept
 
     m_doc = qobject_cast<DocumentView *>(widget);
 
+    // Before anything asks the model for the outline or the page count
+    if (m_doc)
+        m_doc->resume();
+
     updateMenuActions();
     updateUiEnabledState();
     updatePanel();
@@ -3311,6 +3514,7 @@ lektra::initActionMap() noexcept
         ACTION_NO_ARGS("link_hint_copy", CopyLinkKB),
         ACTION_NO_ARGS("outline", ShowOutline),
         ACTION_NO_ARGS("highlight_annot_search", ShowHighlightSearch),
+        ACTION_NO_ARGS("search_all_tabs", SearchAllTabs),
         ACTION_NO_ARGS("rotate_clock", RotateClock),
         ACTION_NO_ARGS("rotate_anticlock", RotateAnticlock),
         ACTION_NO_ARGS("prev_location", GoBackHistory),
@@ -3698,7 +3902,7 @@ void
 lektra::search(const QString &term) noexcept
 {
     if (m_doc)
-        m_doc->Search(term);
+        m_doc->Search(term, m_search_bar->options());
 }
 
 void
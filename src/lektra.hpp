@@ -14,6 +14,7 @@
 #include "SearchBar.hpp"
 #include "StartupWidget.hpp"
 #include "Statusbar.hpp"
+#include "TabSearchWidget.hpp"
 #include "TabWidget.hpp"
 #include "argparse.hpp"
 
@@ -65,6 +66,7 @@ public:
     // bool OpenFile(DocumentView *view) noexcept;
     void Search() noexcept;
     void ShowHighlightSearch() noexcept;
+    void SearchAllTabs() noexcept;
     void ToggleAutoResize() noexcept;
     void ToggleCommandPalette() noexcept;
     void ToggleFocusMode() noexcept;
@@ -198,6 +200,9 @@ private:
     void gotoPage(int pageno) noexcept;
     void setFocusMode(bool state) noexcept;
     void search(const QString &term = {}) noexcept;
+    void searchAllTabs(const QString &term) noexcept;
+    void gotoTabLocation(const QString &filePath, int page,
+                         const QPointF &pos) noexcept;
     void writeSessionToFile(const QString &sessionName) noexcept;
 
     // private helpers
@@ -306,6 +311,7 @@ private:
     QAction *m_actionSessionSave{nullptr};
     QAction *m_actionSessionSaveAs{nullptr};
     QAction *m_actionHighlightSearch{nullptr};
+    QAction *m_actionSearchAllTabs{nullptr};
     QAction *m_actionSetMark{nullptr};
     QAction *m_actionGotoMark{nullptr};
     QAction *m_actionDeleteMark{nullptr};
@@ -353,6 +359,7 @@ private:
     MessageBar *m_message_bar{nullptr};
     SearchBar *m_search_bar{nullptr};
     HighlightSearchWidget *m_highlight_search_widget{nullptr};
+    TabSearchWidget *m_tab_search_widget{nullptr}; // made on first use
     CommandPaletteWidget *m_command_palette_widget{nullptr};
     FloatingOverlayWidget *m_command_palette_overlay{nullptr};
     // MarkManager m_marks_manager;